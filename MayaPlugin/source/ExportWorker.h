@@ -0,0 +1,223 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <deque>
+#include <memory>
+#include <vector>
+#include "Profiler.h"
+
+/*
+	Dedicated thread for packing and Comlib::Send, so a slow viewer never stalls Maya's main thread.
+	The main thread only reads from Maya and queues jobs, which run one at a time in the order they were queued.
+	The queue is bounded by job count and bytes, when it's full the main thread waits (back-pressure).
+	Jobs must not call the Maya API.
+*/
+class ExportWorker
+{
+public:
+	static const size_t MAX_JOBS = 4096;
+	static const size_t MAX_BYTES = 512 * MB;
+
+	void start()
+	{
+		if (running)
+			return;
+
+		stopping = false;
+		running = true;
+		thread = std::thread(&ExportWorker::run, this);
+	}
+
+	// Finishes the queued jobs first
+	void stop()
+	{
+		if (!running)
+			return;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		jobAdded.notify_one();
+
+		thread.join();
+		running = false;
+	}
+
+	bool isRunning() const { return running; }
+	bool onWorkerThread() const { return std::this_thread::get_id() == thread.get_id(); }
+
+	// bytes is roughly what the job holds on to, a single job larger than MAX_BYTES is still accepted into an empty queue
+	void push(std::function<void()> job, size_t bytes = 0)
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+
+		auto full = [&] { return jobs.size() >= MAX_JOBS || (!jobs.empty() && queuedBytes + bytes > MAX_BYTES); };
+
+		stats.pushed++;
+		if (full())
+		{
+			const auto start = std::chrono::steady_clock::now();
+			jobDone.wait(lock, [&] { return !full(); });
+
+			stats.blocked++;
+			stats.blockedMs += std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+		}
+
+		jobs.push_back({ std::move(job), bytes });
+		queuedBytes += bytes;
+
+		stats.maxJobs = std::max(stats.maxJobs, jobs.size());
+		stats.maxBytes = std::max(stats.maxBytes, queuedBytes);
+
+		lock.unlock();
+		jobAdded.notify_one();
+	}
+
+	std::string report()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		char line[512];
+		snprintf(line, sizeof(line),
+			"\nexport queue: %zu jobs (%zu bytes) queued, %llu pushed, %llu waited on a full queue for %.2f ms, peak %zu jobs / %zu bytes\n",
+			jobs.size(), queuedBytes, (unsigned long long)stats.pushed, (unsigned long long)stats.blocked, stats.blockedMs, stats.maxJobs, stats.maxBytes);
+
+		return line;
+	}
+
+	void resetStats()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stats = Stats();
+	}
+
+private:
+	struct Job
+	{
+		std::function<void()> function;
+		size_t bytes = 0;
+	};
+
+	struct Stats
+	{
+		uint64_t pushed = 0;
+		uint64_t blocked = 0;
+		float blockedMs = 0.f;
+		size_t maxJobs = 0;
+		size_t maxBytes = 0;
+	};
+
+	void run()
+	{
+		while (true)
+		{
+			Job job;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				jobAdded.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+				if (jobs.empty())
+					return;
+
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+
+			job.function();
+
+			// The bytes are held until the job is done with them
+			{
+				std::lock_guard<std::mutex> lock(mutex);
+				queuedBytes -= job.bytes;
+			}
+			jobDone.notify_all();
+		}
+	}
+
+	std::thread thread;
+	std::deque<Job> jobs;
+	size_t queuedBytes = 0;
+	bool stopping = false;
+	bool running = false;
+	Stats stats;
+
+	std::mutex mutex;
+	std::condition_variable jobAdded;
+	std::condition_variable jobDone;
+};
+
+inline ExportWorker& exportWorker()
+{
+	static ExportWorker worker;
+	return worker;
+}
+
+// Queues job on the export worker, or runs it right away when already on it (or when it isn't running)
+inline void runOnExportWorker(std::function<void()> job, size_t bytes = 0)
+{
+	ExportWorker& worker = exportWorker();
+	if (worker.isRunning() && !worker.onWorkerThread())
+		worker.push(std::move(job), bytes);
+	else
+		job();
+}
+
+// How long the export worker retries a message the ring has no room for, see sendMessage
+constexpr int SEND_RETRY_MS = 5000;
+
+/*
+	Comlib::Send, timed on its own since it can wait on the viewer's mutex.
+	Called off the export worker the message is copied and the send queued, the result is then always true.
+	On the export worker a failed send is retried until SEND_RETRY_MS has passed: Send fails whenever the ring wraps
+	or is full, and the caches on both sides rely on every message arriving. Once a retry has timed out (the viewer
+	isn't draining the ring) later messages get a single attempt until one goes through again.
+*/
+inline bool sendMessage(Comlib* pComlib, char* message, SectionHeader* secHeader)
+{
+	ExportWorker& worker = exportWorker();
+	if (worker.isRunning() && !worker.onWorkerThread())
+	{
+		const size_t length = message ? secHeader->messageLength : 0;
+		std::shared_ptr<std::vector<char>> pCopy = std::make_shared<std::vector<char>>(message, message + length);
+		const SectionHeader header = *secHeader;
+
+		worker.push([pComlib, pCopy, header]
+		{
+			SectionHeader queuedHeader = header;
+			sendMessage(pComlib, pCopy->data(), &queuedHeader);
+		}, length);
+
+		return true;
+	}
+
+	// Only touched on the export worker
+	static bool stalled = false;
+	const bool retry = worker.onWorkerThread() && !stalled;
+
+	bool sent = false;
+	{
+		ScopedTimer timer("Comlib::Send");
+
+		const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(SEND_RETRY_MS);
+		for (int attempt = 0; !(sent = pComlib->Send(message, secHeader)) && retry; attempt++)
+		{
+			if (std::chrono::steady_clock::now() > deadline)
+				break;
+
+			// The first retry covers the wrap marker Send just wrote, after that the viewer has to drain the ring
+			if (attempt > 0)
+				std::this_thread::sleep_for(std::chrono::milliseconds(1));
+		}
+	}
+
+	if (worker.onWorkerThread())
+		stalled = !sent;
+
+	exportProfiler().addMessage(secHeader->header, secHeader->messageLength, sent);
+	return sent;
+}
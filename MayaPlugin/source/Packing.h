@@ -0,0 +1,110 @@
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+/*
+	Helpers for writing PackedVertex (see Headers.h).
+	The matching decode lives in the viewer's skinning-none.vert (PACKED_VERTEX).
+*/
+
+inline uint16_t floatToHalf(float value)
+{
+	uint32_t bits;
+	memcpy(&bits, &value, sizeof(float));
+
+	const uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+	const int exponent = (int)((bits >> 23) & 0xff) - 127 + 15;
+	uint32_t mantissa = bits & 0x7fffff;
+
+	// NaN & Inf
+	if (((bits >> 23) & 0xff) == 0xff)
+		return sign | 0x7c00 | (mantissa ? 0x200 : 0);
+
+	// Overflow, clamp to Inf
+	if (exponent >= 0x1f)
+		return sign | 0x7c00;
+
+	// Denormal or zero
+	if (exponent <= 0)
+	{
+		if (exponent < -10)
+			return sign;
+
+		mantissa |= 0x800000;
+		const int shift = 14 - exponent;
+		uint16_t half = (uint16_t)(mantissa >> shift);
+
+		// Round to nearest
+		if ((mantissa >> (shift - 1)) & 1)
+			half++;
+
+		return sign | half;
+	}
+
+	uint16_t half = (uint16_t)(sign | (exponent << 10) | (mantissa >> 13));
+
+	// Round to nearest, a carry into the exponent is still correct
+	if (mantissa & 0x1000)
+		half++;
+
+	return half;
+}
+
+inline int16_t toSnorm16(float value)
+{
+	value = value < -1.f ? -1.f : value > 1.f ? 1.f : value;
+	return (int16_t)std::lround(value * 32767.f);
+}
+
+inline uint16_t toUnorm16(float value)
+{
+	value = value < 0.f ? 0.f : value > 1.f ? 1.f : value;
+	return (uint16_t)std::lround(value * 65535.f);
+}
+
+// Maps a unit vector onto the octahedron, then unfolds it onto the [-1, 1] square
+inline void encodeOctahedral(float x, float y, float z, int16_t out[2])
+{
+	const float length = std::fabs(x) + std::fabs(y) + std::fabs(z);
+	if (length == 0.f)
+	{
+		out[0] = out[1] = 0;
+		return;
+	}
+
+	float u = x / length;
+	float v = y / length;
+
+	if (z < 0.f)
+	{
+		const float foldedU = (1.f - std::fabs(v)) * (u >= 0.f ? 1.f : -1.f);
+		const float foldedV = (1.f - std::fabs(u)) * (v >= 0.f ? 1.f : -1.f);
+		u = foldedU;
+		v = foldedV;
+	}
+
+	out[0] = toSnorm16(u);
+	out[1] = toSnorm16(v);
+}
+
+// FNV-1a over 64 bit words, used to recognize identical packed geometry
+inline uint64_t hashBytes(const char* pData, size_t size)
+{
+	const uint64_t PRIME = 0x100000001b3ull;
+	uint64_t hash = 0xcbf29ce484222325ull;
+
+	size_t i = 0;
+	for (; i + sizeof(uint64_t) <= size; i += sizeof(uint64_t))
+	{
+		uint64_t word;
+		memcpy(&word, pData + i, sizeof(uint64_t));
+		hash = (hash ^ word) * PRIME;
+	}
+
+	for (; i < size; i++)
+		hash = (hash ^ (unsigned char)pData[i]) * PRIME;
+
+	return hash;
+}
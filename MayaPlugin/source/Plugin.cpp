@@ -4,42 +4,227 @@
 #include <vector>
 #include <queue>
 #include <unordered_map>
+#include <unordered_set>
 
 #include "Send.h"
+#include "WorkerPool.h"
 
 Comlib* producerBuffer;
-std::unordered_map<std::string, MCallbackId> callbacks;
 MStatus status = MS::kSuccess;
 
-void addCallback(const std::string& name, MCallbackId id)
+/*
+	Callbacks are keyed by node handle, each node holding a small list of (type, id).
+	This avoids building strings per registration and lets nodeRemoved
+	drop every callback of a deleted node with a single lookup.
+*/
+enum CallbackType
 {
-	static int i = 0;
-	std::string tempName = name;
+	CB_NAME_CHANGED,
+	CB_DIRTY_PLUG,
+	CB_TOPO_CHANGED,
+	CB_TOPO_ATTRIBUTE,
+	CB_MESH_ATTRIBUTE,
+	CB_MESH_MATERIAL,
+	CB_TRANSFORM,
+	CB_MATERIAL,
+	CB_FILE_TEXTURE,
+	CB_SKIN_CLUSTER
+};
+
+struct NodeCallback
+{
+	CallbackType type;
+	MCallbackId id;
+};
+
+struct HandleHash
+{
+	size_t operator()(const MObjectHandle& handle) const { return handle.hashCode(); }
+};
+
+std::unordered_map<MObjectHandle, std::vector<NodeCallback>, HandleHash> nodeCallbacks;
+MCallbackIdArray globalCallbacks;
+
+// Camera panels, the focused one is tracked through ModelPanelSetFocus
+const char* cameraPanels[] = { "modelPanel1", "modelPanel2", "modelPanel3", "modelPanel4" };
+std::string activePanel;
+
+// Inserted into on the main thread only, the entries themselves belong to the export worker (see sendCamera)
+std::unordered_map<std::string, SentCamera> sentCameras;
+
+// Geometry already in Gameplay3D, duplicated meshes are sent as MESH_INSTANCE
+GeometryCache geometryCache;
+
+// Transforms whose animation Gameplay3D plays back from an exported clip
+std::unordered_set<MObjectHandle, HandleHash> clippedTransforms;
 
-	if (callbacks.count(name))
-		tempName += i++;
+// From a time change (playing or scrubbing) until Maya is idle again. The transform changes in between are the
+// evaluation of the new time, which Gameplay3D gets from its clips & the TIME_SYNC
+MCallbackId timeChangeIdleId = 0;
 
-	callbacks[tempName] = id;
+// Skinned mesh shapes, Gameplay3D deforms their bind pose with the joint matrices
+struct SkinBinding
+{
+	std::string name;
+	MDagPathArray influences;
+
+	// Owned by the export worker's jobs, see sendJointMatrices. Replaced rather than cleared on the main thread
+	std::shared_ptr<std::vector<float>> lastSent = std::make_shared<std::vector<float>>();
+};
+
+std::unordered_map<MObjectHandle, SkinBinding, HandleHash> skinnedMeshes;
+
+// Material state in Gameplay3D per shader name, edits only send the fields that changed.
+// Inserted into on the main thread only, the entries themselves belong to the export worker (see SendMaterialData)
+std::unordered_map<std::string, SentMaterial> sentMaterials;
+
+std::vector<NodeCallback>& getCallbacks(const MObject& node)
+{
+	return nodeCallbacks[MObjectHandle(node)];
+}
+
+void addCallback(const MObject& node, CallbackType type, MCallbackId id)
+{
+	getCallbacks(node).push_back({ type, id });
 }
-void addCallbackDelOld(const std::string& name, MCallbackId id)
+
+void removeCallback(const MObject& node, CallbackType type)
 {
-	if (callbacks.count(name))
-		MMessage::removeCallback(callbacks[name]);
+	auto it = nodeCallbacks.find(MObjectHandle(node));
+	if (it == nodeCallbacks.end())
+		return;
 
-	callbacks[name] = id;
+	std::vector<NodeCallback>& list = it->second;
+	for (size_t i = 0; i < list.size();)
+	{
+		if (list[i].type == type)
+		{
+			MMessage::removeCallback(list[i].id);
+			list[i] = list.back();
+			list.pop_back();
+		}
+		else
+			i++;
+	}
+}
+
+// Replaces any earlier callback of the same type
+void replaceCallback(const MObject& node, CallbackType type, MCallbackId id)
+{
+	removeCallback(node, type);
+	addCallback(node, type, id);
 }
-void removeCallback(const std::string& name)
+
+void removeCallbacks(const MObject& node)
 {
-	if (callbacks.find(name) == callbacks.end())
+	auto it = nodeCallbacks.find(MObjectHandle(node));
+	if (it == nodeCallbacks.end())
 		return;
 
-	MNodeMessage::removeCallback(callbacks[name]);
-	callbacks.erase(name);
+	MCallbackIdArray ids;
+	for (const NodeCallback& callback : it->second)
+		ids.append(callback.id);
+
+	MMessage::removeCallbacks(ids);
+	nodeCallbacks.erase(it);
+}
+
+// Prints the export profiler's stats and returns them as a string, "exportStats -reset" clears them
+class ExportStatsCommand : public MPxCommand
+{
+public:
+	static void* creator() { return new ExportStatsCommand; }
+
+	MStatus doIt(const MArgList& args) override
+	{
+		if (args.length() > 0 && args.asString(0) == "-reset")
+		{
+			exportProfiler().reset();
+			exportWorker().resetStats();
+			return MS::kSuccess;
+		}
+
+		const std::string report = exportProfiler().report() + exportWorker().report();
+		std::cout << report << std::endl;
+		setResult(report.c_str());
+
+		return MS::kSuccess;
+	}
+};
+
+// Seconds between the snapshots appended to the trace file
+const float TRACE_PERIOD = 5.f;
+
+void writeProfilerTrace(float elapsedTime, float lastTime, void* clientData)
+{
+	exportProfiler().writeTrace();
+}
+
+void sendAllJointMatrices()
+{
+	for (auto& skinned : skinnedMeshes)
+		sendJointMatrices(skinned.second.name, skinned.second.influences, producerBuffer, skinned.second.lastSent);
+}
+
+// Skinned meshes only send their bind pose, deformations follow as JOINT_MATRICES
+bool sendMeshNode(const MObject& node, Headers header = MESH_NEW)
+{
+	MObject skinCluster = findSkinCluster(node);
+	if (skinCluster.isNull())
+	{
+		skinnedMeshes.erase(MObjectHandle(node));
+		return sendMesh(node, producerBuffer, &geometryCache, header);
+	}
+
+	if (!sendSkinnedMesh(node, skinCluster, producerBuffer, &geometryCache))
+		return false;
+
+	SkinBinding& binding = skinnedMeshes[MObjectHandle(node)];
+	binding.name = MFnDagNode(MFnDagNode(node).parent(0)).name().asChar();
+	MFnSkinCluster(skinCluster).influenceObjects(binding.influences);
+
+	// Gameplay3D has a new skin, its joints start from scratch
+	binding.lastSent = std::make_shared<std::vector<float>>();
+	return sendJointMatrices(binding.name, binding.influences, producerBuffer, binding.lastSent);
+}
+
+bool sendMaterialNode(const MFnDependencyNode& material)
+{
+	return SendMaterialData(material, producerBuffer, &sentMaterials[material.name().asChar()]);
 }
 
+void skinClusterAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug, MPlug& otherPlug, void* clientData)
+{
+	PROFILE_FUNCTION();
+
+	// Binding connects the output geometry, painting weights sets the weightList
+	const bool bound = (msg & MNodeMessage::kConnectionMade) && otherPlug.node().hasFn(MFn::kMesh);
+	const bool weightsChanged = (msg & MNodeMessage::kAttributeSet) && std::string(plug.name().asChar()).find(".weightList") != -1;
+	if (!bound && !weightsChanged)
+		return;
+
+	MFnSkinCluster skin(plug.node(), &status);
+	if (M_FAIL2)
+		return;
+
+	MObjectArray outputs;
+	if (M_FAIL(skin.getOutputGeometry(outputs)))
+		return;
+
+	for (unsigned int i = 0; i < outputs.length(); i++)
+	{
+		if (!outputs[i].hasFn(MFn::kMesh))
+			continue;
+
+		sendMeshNode(outputs[i]);
+		sendAttachedMaterial(outputs[i], producerBuffer);
+	}
+}
 
 void meshAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug, MPlug& otherPlug, void* clientData)
 {
+	PROFILE_FUNCTION();
+
 	if (msg & MNodeMessage::AttributeMessage::kAttributeSet)
 	{
 		MFnMesh mesh(plug.node(), &status);
@@ -50,7 +235,7 @@ void meshAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug, MPlug
 
 		if (plugName.find(".pnts[") != -1)
 		{
-			sendUpdateMesh(plug.node(), producerBuffer);
+			sendMeshNode(plug.node(), MESH_UPDATE);
 		}
 
 	}
@@ -58,18 +243,19 @@ void meshAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug, MPlug
 
 void meshTopoAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug, MPlug& otherPlug, void* clientData)
 {
+	PROFILE_FUNCTION();
+
 	if (msg & MNodeMessage::AttributeMessage::kAttributeEval)
 	{
 		MFnMesh mesh(plug.node(), &status);
-		std::string nodeName = mesh.name().asChar();
 		std::string plugName = plug.name().asChar();
 
 		if (M_OK2)
 		{
 			if (plugName.find(".outMesh") != -1)
 			{
-				removeCallback(nodeName + "meshTopoAttriCB");
-				sendMesh(plug.node(), producerBuffer);	
+				removeCallback(plug.node(), CB_TOPO_ATTRIBUTE);
+				sendMeshNode(plug.node());	
 			}
 		}
 	}
@@ -77,12 +263,14 @@ void meshTopoAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug, M
 
 void fileTextureAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug, MPlug& otherPlug, void* clientData)
 {
+	PROFILE_FUNCTION();
+
 	// Early out if a connection was changed and otherPlug.node() is the material
 	if (msg & MNodeMessage::kConnectionBroken || msg & MNodeMessage::kConnectionMade)
 	{
 		if (otherPlug.node().hasFn(MFn::kLambert))
 		{
-			SendMaterialData(MFnDependencyNode(otherPlug.node()), producerBuffer);
+			sendMaterialNode(MFnDependencyNode(otherPlug.node()));
 			return;
 		}
 	}
@@ -107,7 +295,7 @@ void fileTextureAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug
 
 					if (curNode.hasFn(MFn::kLambert))
 					{
-						SendMaterialData(MFnDependencyNode(curNode), producerBuffer);
+						sendMaterialNode(MFnDependencyNode(curNode));
 					}
 				}
 			}
@@ -143,7 +331,7 @@ void fileTextureAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug
 							MObject curNodeJ = connections[j].node();
 							if (curNodeJ.hasFn(MFn::kLambert))
 							{
-								SendMaterialData(MFnDependencyNode(curNodeJ), producerBuffer);
+								sendMaterialNode(MFnDependencyNode(curNodeJ));
 								continue;
 							}
 						}
@@ -174,7 +362,7 @@ void fileTextureAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug
 				{
 					MFnDependencyNode lambert(connections[i].node(), &status);
 					if (M_OK2)
-						SendMaterialData(lambert, producerBuffer);
+						sendMaterialNode(lambert);
 				}
 			}
 		}
@@ -183,6 +371,8 @@ void fileTextureAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug
 
 void materialAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug, MPlug& otherPlug, void* x)
 {
+	PROFILE_FUNCTION();
+
 	if (msg & MNodeMessage::kConnectionMade || msg & MNodeMessage::kConnectionBroken)
 	{
 		MObject node = plug.node();
@@ -191,12 +381,12 @@ void materialAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug, M
 
 		if (otherNode.hasFn(MFn::kShadingEngine))
 		{
-			SendMaterialData(material, producerBuffer); 
+			sendMaterialNode(material);
 		}
 
 		if (otherNode.hasFn(MFn::kBump))
 		{
-			SendMaterialData(material, producerBuffer);
+			sendMaterialNode(material);
 		}
 
 
@@ -206,13 +396,15 @@ void materialAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug, M
 		if (plug.node().hasFn(MFn::kLambert))
 		{
 			MFnDependencyNode material(plug.node());
-			SendMaterialData(material, producerBuffer);
+			sendMaterialNode(material);
 		}
 	}
 }
 
 void meshSetMaterial(MNodeMessage::AttributeMessage msg, MPlug& plug, MPlug& otherPlug, void* x)
 {
+	PROFILE_FUNCTION();
+
 	if (msg & MNodeMessage::kConnectionMade)
 	{
 		MObject otherNode = otherPlug.node(&status);
@@ -228,56 +420,164 @@ void meshSetMaterial(MNodeMessage::AttributeMessage msg, MPlug& plug, MPlug& oth
 
 void meshTopoChanged(MObject& node, void* clientData)
 {
+	PROFILE_FUNCTION();
+
 	MCallbackId callbackId = MNodeMessage::addAttributeChangedCallback(node, meshTopoAttributeChanged, nullptr, &status);
-	std::string name = MFnDependencyNode(node).name().asChar();
 	if (M_OK2)
-		addCallback(name + "meshTopoAttriCB", callbackId);
+		replaceCallback(node, CB_TOPO_ATTRIBUTE, callbackId);
 }
 
 void meshDirtyPlug(MObject& node, MPlug& plug, void* clientData)
 {
+	PROFILE_FUNCTION();
+
 	MFnMesh mesh(node, &status);
 	if (M_OK2)
 	{
-		std::string nodeName = mesh.name().asChar();
-
 		if (std::string(plug.name().asChar()).find(".inMesh") != -1)
 		{
-			removeCallback(nodeName + "DirtyPlug");
+			removeCallback(node, CB_DIRTY_PLUG);
 
-			sendMesh(node, producerBuffer);
+			sendMeshNode(node);
 
 			MCallbackId id = MNodeMessage::addAttributeChangedCallback(node, meshSetMaterial, nullptr, &status);
 			if (M_OK2)
-				addCallback(nodeName + "MeshMatAttriChanged", id);
+				replaceCallback(node, CB_MESH_MATERIAL, id);
 
 			sendAttachedMaterial(node, producerBuffer);
 		}
 	}
 }
 
+void exportClip(const MObject& node)
+{
+	if (!sendAnimationClip(node, producerBuffer))
+		return;
+
+	if (MAnimUtil::isAnimated(node))
+		clippedTransforms.insert(MObjectHandle(node));
+	else
+		clippedTransforms.erase(MObjectHandle(node));
+}
+
+void timeChangeEvaluated(void* clientData)
+{
+	// One shot, the next time change registers it again
+	MMessage::removeCallback(timeChangeIdleId);
+	timeChangeIdleId = 0;
+}
+
+void timeChanged(MTime& time, void* clientData)
+{
+	PROFILE_FUNCTION();
+
+	if (!timeChangeIdleId)
+	{
+		MCallbackId id = MEventMessage::addEventCallback("idle", timeChangeEvaluated, nullptr, &status);
+		if (M_OK2)
+			timeChangeIdleId = id;
+	}
+
+	sendTimeSync(producerBuffer);
+	sendAllJointMatrices();
+}
+
+void animCurveEdited(MObjectArray& editedCurves, void* clientData)
+{
+	PROFILE_FUNCTION();
+
+	// Re-export every transform driven by the edited curves, directly or through blend/conversion nodes
+	std::unordered_set<MObjectHandle, HandleHash> driven;
+
+	for (unsigned int i = 0; i < editedCurves.length(); i++)
+	{
+		MItDependencyGraph graphIterator(editedCurves[i], MFn::kTransform, MItDependencyGraph::kDownstream,
+			MItDependencyGraph::kBreadthFirst, MItDependencyGraph::kNodeLevel, &status);
+		if (M_FAIL2)
+			continue;
+
+		for (; !graphIterator.isDone(); graphIterator.next())
+		{
+			// Joints reach Gameplay3D through JOINT_MATRICES instead
+			MObject node = graphIterator.currentItem();
+			if (!node.hasFn(MFn::kJoint) && driven.insert(MObjectHandle(node)).second)
+				exportClip(node);
+		}
+	}
+
+	if (!driven.empty())
+		sendTimeSync(producerBuffer);
+
+	sendAllJointMatrices();
+}
+
 void transformAttributeChanged(MNodeMessage::AttributeMessage msg, MPlug& plug, MPlug& otherPlug, void* x)
 {
+	PROFILE_FUNCTION();
+
 	if (msg & MNodeMessage::AttributeMessage::kAttributeSet)
 	{
 		MObject obj(plug.node());
 		if (obj.hasFn(MFn::kTransform))
 		{
+			// Gameplay3D is already playing or scrubbing this node's clip, only edits outside of a time change are sent
+			if ((timeChangeIdleId || MAnimControl::isPlaying()) && clippedTransforms.count(MObjectHandle(obj)))
+				return;
+
 			SendTransformData(obj, producerBuffer);
+
+			if (obj.hasFn(MFn::kJoint))
+				sendAllJointMatrices();
+		}
+	}
+}
+
+void parentAdded(MDagPath& child, MDagPath& parent, void* clientData)
+{
+	PROFILE_FUNCTION();
+
+	// Keeps Gameplay3D's hierarchy in sync when a transform is reparented
+	MObject node = child.node();
+	if (node.hasFn(MFn::kTransform))
+		SendTransformData(node, producerBuffer);
+}
+
+void panelFocusChanged(void* clientData)
+{
+	PROFILE_FUNCTION();
+
+	M3dView active = M3dView::active3dView(&status);
+	if (M_FAIL2)
+		return;
+
+	for (const char* panel : cameraPanels)
+	{
+		M3dView view;
+		if (M3dView::getM3dViewFromModelPanel(panel, view) == MS::kSuccess && view.widget() == active.widget())
+		{
+			activePanel = panel;
+
+			// Gameplay3D has to switch to this panel's camera even if it hasn't moved. Reset on the worker, which may
+			// still be comparing against the entry
+			SentCamera* pSent = &sentCameras[activePanel];
+			runOnExportWorker([pSent] { *pSent = SentCamera(); });
+			return;
 		}
 	}
 }
 
 void cameraMoved(const MString& str, void* clientData)
 {
-	MString activePanel = MGlobal::executeCommandStringResult("getPanel -wf");
+	PROFILE_FUNCTION();
 
-	if (strcmp(str.asChar(), activePanel.asChar()) == 0)
-		sendCamera(M3dView::active3dView(), producerBuffer);
+	if (activePanel == str.asChar())
+		sendCamera(M3dView::active3dView(), producerBuffer, &sentCameras[activePanel]);
 }
 
 void nodeNameChange(MObject& node, const MString& prevName, void* clientData)
 {
+	PROFILE_FUNCTION();
+
 	MFnTransform traNode(node, &status);
 	if (M_OK2)
 	{
@@ -291,14 +591,190 @@ void nodeNameChange(MObject& node, const MString& prevName, void* clientData)
 		secHeader.name = prevName.asChar();
 		secHeader.messageLength = sizeof(NameChangeHeader);
 
-		producerBuffer->Send((char*)&nameChange, &secHeader);
+		// The cache belongs to the export worker, renaming is queued behind the meshes it may still be sending
+		const std::string oldName = prevName.asChar();
+		const std::string newName = nameChange.newName.cStr;
+		runOnExportWorker([oldName, newName] { geometryCache.rename(oldName, newName); });
+
+		sendMessage(producerBuffer, (char*)&nameChange, &secHeader);
 	}
 }
 
+struct PendingMesh
+{
+	MObject node;
+	bool visible = true;
+	double distance = 0.0;
+
+	MeshData data;
+	char* pMessage = nullptr;
+	size_t size = 0;
+	char* pProxy = nullptr;
+	size_t proxySize = 0;
+	std::future<void> packed;
+};
+
+// Meshes inside the active camera's view go first, nearest first within each group
+void prioritizeMeshes(std::vector<PendingMesh>& meshes)
+{
+	M3dView view = M3dView::active3dView(&status);
+	if (M_FAIL2)
+		return;
+
+	MDagPath camPath;
+	if (M_FAIL(view.getCamera(camPath)))
+		return;
+
+	MFnCamera camera(camPath, &status);
+	if (M_FAIL2)
+		return;
+
+	const MMatrix worldToCamera = camPath.inclusiveMatrixInverse();
+	const bool ortho = camera.isOrtho();
+	const double tanHalfH = tan(camera.horizontalFieldOfView() * 0.5);
+	const double tanHalfV = tan(camera.verticalFieldOfView() * 0.5);
+
+	for (PendingMesh& mesh : meshes)
+	{
+		MDagPath path;
+		if (M_FAIL(MDagPath::getAPathTo(mesh.node, path)))
+			continue;
+
+		MBoundingBox box = MFnDagNode(path).boundingBox();
+		box.transformUsing(path.inclusiveMatrix());
+
+		// Bounding sphere in camera space, Maya cameras look down -z
+		const MPoint center = box.center() * worldToCamera;
+		const double radius = (box.max() - box.min()).length() * 0.5;
+		const double depth = -center.z;
+
+		mesh.distance = MVector(center).length();
+		mesh.visible = ortho || (depth + radius > 0.0 &&
+			(fabs(center.x) - depth * tanHalfH) <= radius * sqrt(1.0 + tanHalfH * tanHalfH) &&
+			(fabs(center.y) - depth * tanHalfV) <= radius * sqrt(1.0 + tanHalfV * tanHalfV));
+	}
+
+	std::stable_sort(meshes.begin(), meshes.end(), [](const PendingMesh& a, const PendingMesh& b)
+	{
+		if (a.visible != b.visible)
+			return a.visible;
+
+		return a.distance < b.distance;
+	});
+}
+
+void syncMeshes(std::vector<PendingMesh>& meshes)
+{
+	PROFILE_FUNCTION();
+
+	/*
+		Gathering needs the Maya API and stays on the main thread,
+		packing runs on the workers while the main thread gathers the next mesh.
+		Meshes are sent in priority order as soon as they're packed.
+	*/
+
+	prioritizeMeshes(meshes);
+
+	const bool showProgress = MProgressWindow::reserve();
+	if (showProgress)
+	{
+		MProgressWindow::setTitle("Gameplay3D");
+		MProgressWindow::setProgressStatus("Sending meshes");
+		MProgressWindow::setProgressRange(0, (int)meshes.size());
+		MProgressWindow::startProgress();
+	}
+
+	WorkerPool workers;
+	size_t numSent = 0;
+
+	auto sendPacked = [&](bool wait)
+	{
+		while (numSent < meshes.size() && meshes[numSent].packed.valid())
+		{
+			PendingMesh& mesh = meshes[numSent];
+			if (!wait && mesh.packed.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+				return;
+
+			mesh.packed.get();
+			if (mesh.pMessage)
+			{
+				// The export worker takes over both buffers
+				const std::string name = mesh.data.name;
+				char* pMessage = mesh.pMessage;
+				char* pProxy = mesh.pProxy;
+				const size_t size = mesh.size;
+				const size_t proxySize = mesh.proxySize;
+
+				runOnExportWorker([name, pMessage, pProxy, size, proxySize]
+				{
+					sendPackedMesh(MESH_NEW, name, pMessage, size, producerBuffer, &geometryCache, pProxy, proxySize);
+					free(pMessage);
+					free(pProxy);
+				}, size + proxySize);
+
+				mesh.pMessage = nullptr;
+				mesh.pProxy = nullptr;
+
+				sendAttachedMaterial(mesh.node, producerBuffer);
+			}
+
+			// Release the gathered copy early, large scenes would otherwise hold all of it
+			mesh.data = MeshData();
+			numSent++;
+
+			if (showProgress)
+				MProgressWindow::setProgress((int)numSent);
+		}
+	};
+
+	for (PendingMesh& mesh : meshes)
+	{
+		if (gatherMesh(mesh.node, mesh.data))
+		{
+			PendingMesh* pMesh = &mesh;
+			mesh.packed = workers.push([pMesh]
+			{
+				pMesh->pMessage = packMesh(pMesh->data, pMesh->size);
+
+				MeshData proxy;
+				if (buildProxyMesh(pMesh->data, proxy))
+					pMesh->pProxy = packMesh(proxy, pMesh->proxySize);
+			});
+		}
+		else
+		{
+			std::promise<void> failed;
+			mesh.packed = failed.get_future();
+			failed.set_value();
+		}
+
+		sendPacked(false);
+	}
+
+	sendPacked(true);
+
+	if (showProgress)
+		MProgressWindow::endProgress();
+
+	std::cout << "Initial sync: sent " << numSent << " meshes\n";
+}
+
 void iterateScene()
 {
+	PROFILE_FUNCTION();
+
 	MCallbackId id;
 
+	// CAMERA (first, so the viewer looks at the right place while the rest streams in)
+	M3dView view = M3dView::active3dView();
+	sendCamera(view, producerBuffer);
+
+	MDagPath camPath;
+	view.getCamera(camPath);
+	MFnCamera camera(camPath, &status);
+	if (M_OK2)
+		SendTransformData(camera.parent(0), producerBuffer);
+
 	// FILE TEXTURE
 	MItDependencyNodes fileIterator(MFn::kFileTexture, &status);
 	if (M_OK2)
@@ -313,10 +789,7 @@ void iterateScene()
 
 			id = MNodeMessage::addAttributeChangedCallback(node, fileTextureAttributeChanged, nullptr, &status);
 			if (M_OK2)
-			{
-				std::string textureNodeName = dgNode.name().asChar();
-				addCallbackDelOld(textureNodeName + "FileTextureChanged", id);
-			}
+				replaceCallback(node, CB_FILE_TEXTURE, id);
 		}
 	}
 
@@ -327,80 +800,124 @@ void iterateScene()
 		for (; !matIterator.isDone(); matIterator.next())
 		{
 			MFnDependencyNode dgNode(matIterator.thisNode());
-			std::string name = dgNode.name().asChar();
 			MObject node = matIterator.thisNode();
 
 			id = MNodeMessage::addAttributeChangedCallback(node, materialAttributeChanged, NULL, &status);
 			if (M_OK2)
-				addCallback(name + "MaterialChanged", id);
+				addCallback(node, CB_MATERIAL, id);
+
+			sendMaterialNode(dgNode);
+		}
+	}
+
+	// TRANSFORMS (before meshes, so meshes show up in place)
+	std::vector<MObject> animated;
+
+	MItDag transIterator(MItDag::kBreadthFirst, MFn::kTransform, &status);
+	for (; !transIterator.isDone(); transIterator.next())
+	{
+		MObject node(transIterator.currentItem());
+
+
+		MFnTransform tra(node, &status);
+		if (M_OK2)
+		{
+			if (!tra.child(0).hasFn(MFn::kCamera))
+			{
+				id = MNodeMessage::addAttributeChangedCallback(node, transformAttributeChanged, NULL, &status);
+				if (M_OK2)
+					addCallback(node, CB_TRANSFORM, id);
+
+				SendTransformData(node, producerBuffer);
+
+				if (MAnimUtil::isAnimated(node) && !node.hasFn(MFn::kJoint))
+					animated.push_back(node);
+			}
+		}
+	}
 
-			SendMaterialData(dgNode, producerBuffer);
+	// SKIN CLUSTERS
+	MItDependencyNodes skinIterator(MFn::kSkinClusterFilter, &status);
+	if (M_OK2)
+	{
+		for (; !skinIterator.isDone(); skinIterator.next())
+		{
+			MObject node = skinIterator.thisNode();
+
+			id = MNodeMessage::addAttributeChangedCallback(node, skinClusterAttributeChanged, nullptr, &status);
+			if (M_OK2)
+				replaceCallback(node, CB_SKIN_CLUSTER, id);
 		}
 	}
 
 	// MESHES
+	std::vector<PendingMesh> meshes;
+	std::vector<MObject> skinned;
+
 	MItDag meshIterator(MItDag::kBreadthFirst, MFn::kMesh, &status);
 	for (; !meshIterator.isDone(); meshIterator.next())
 	{
-		MFnDependencyNode dgNode(meshIterator.currentItem(), &status);
-		std::string name = dgNode.name().asChar();
-
 		MObject node(meshIterator.currentItem());
 
 		if (node.hasFn(MFn::kMesh))
 		{
+			// One registry lookup for all of the node's callbacks
+			std::vector<NodeCallback>& meshCallbacks = getCallbacks(node);
+
 			id = MPolyMessage::addPolyTopologyChangedCallback(node, meshTopoChanged, nullptr, &status);
 			if (M_OK2)
-				addCallback(name + "TopoChanged", id);
+				meshCallbacks.push_back({ CB_TOPO_CHANGED, id });
 
 			id = MNodeMessage::addAttributeChangedCallback(node, meshAttributeChanged, nullptr, &status);
 			if (M_OK2)
-				addCallback(name + "AttriChanged", id);
+				meshCallbacks.push_back({ CB_MESH_ATTRIBUTE, id });
 
-			MCallbackId id = MNodeMessage::addAttributeChangedCallback(node, meshSetMaterial, nullptr, &status);
+			id = MNodeMessage::addAttributeChangedCallback(node, meshSetMaterial, nullptr, &status);
 			if (M_OK2)
-				addCallback(name + "MeshMatAttriChanged", id);
+				meshCallbacks.push_back({ CB_MESH_MATERIAL, id });
 
-			sendMesh(node, producerBuffer);
-			sendAttachedMaterial(node, producerBuffer);
+			// Skinned meshes need their skinCluster's bind pose, they're sent after the rest
+			if (!findSkinCluster(node).isNull())
+			{
+				skinned.push_back(node);
+				continue;
+			}
+
+			meshes.emplace_back();
+			meshes.back().node = node;
 		}
 	}
 
-	// TRANSFORMS
-	MItDag transIterator(MItDag::kBreadthFirst, MFn::kTransform, &status);
-	for (; !transIterator.isDone(); transIterator.next())
-	{
-		MFnDependencyNode dgNode(transIterator.currentItem(), &status);
-		std::string name = dgNode.name().asChar();
-		MObject node(transIterator.currentItem());
-
-
-		MFnTransform tra(node, &status);
-		if (M_OK2)
-		{
-			if (!tra.child(0).hasFn(MFn::kCamera))
-			{
-				id = MNodeMessage::addAttributeChangedCallback(node, transformAttributeChanged, NULL, &status);
-				if (M_OK2)
-					addCallback(name + "TranformChanged", id);
+	syncMeshes(meshes);
 
-				SendTransformData(node, producerBuffer);
-			}
-		}
+	for (const MObject& node : skinned)
+	{
+		sendMeshNode(node);
+		sendAttachedMaterial(node, producerBuffer);
 	}
 
-	M3dView view = M3dView::active3dView();
-	sendCamera(view, producerBuffer);
+	// ANIMATION (last, sampling the timeline is slow and the scene is already in place)
+	for (const MObject& node : animated)
+		exportClip(node);
 
-	MDagPath camPath;
-	view.getCamera(camPath);
-	MFnCamera camera(camPath, &status);
-	if (M_OK2)
-		SendTransformData(camera.parent(0), producerBuffer);
+	sendTimeSync(producerBuffer);
 }
 
 void nodeRemoved(MObject& node, void* clientData)
 {
+	PROFILE_FUNCTION();
+
+	removeCallbacks(node);
+	clippedTransforms.erase(MObjectHandle(node));
+	skinnedMeshes.erase(MObjectHandle(node));
+
+	// Reset on the worker, which may still be taking a delta against the entry
+	if (node.hasFn(MFn::kLambert))
+	{
+		SentMaterial* pSent = &sentMaterials[MFnDependencyNode(node).name().asChar()];
+		runOnExportWorker([pSent] { *pSent = SentMaterial(); });
+	}
+
 	// Nodes created in Gameplay3D are based on the MFnTransform name
 	MFnTransform traNode(node, &status);
 	if (M_OK2)
@@ -413,46 +930,51 @@ void nodeRemoved(MObject& node, void* clientData)
 		secHeader.header = NODE_DELETE;
 		secHeader.messageLength = 0;
 
-		producerBuffer->Send(nullptr, &secHeader);
+		const std::string name = secHeader.name.cStr;
+		runOnExportWorker([name] { geometryCache.release(name); });
+
+		sendMessage(producerBuffer, nullptr, &secHeader);
 	}
 }
 
 void nodeAdded(MObject& node, void* clientData)
 {
+	PROFILE_FUNCTION();
+
 	MFnDagNode dagNode(node, &status);
 	if (M_OK2)
 	{
 		MCallbackId id;
-		std::string name = dagNode.name().asChar();
+		std::vector<NodeCallback>& dagCallbacks = getCallbacks(node);
 
 		id = MNodeMessage::addNameChangedCallback(node, nodeNameChange, nullptr, &status);
 		if (M_OK2)
-			addCallback(name + "NameChanged", id);
+			dagCallbacks.push_back({ CB_NAME_CHANGED, id });
 
 		if (node.hasFn(MFn::kMesh))
 		{
 			id = MNodeMessage::addNodeDirtyPlugCallback(node, meshDirtyPlug, nullptr, &status);
 			if (M_OK2)
-				addCallback(name + "DirtyPlug", id);
+				dagCallbacks.push_back({ CB_DIRTY_PLUG, id });
 
 			id = MPolyMessage::addPolyTopologyChangedCallback(node, meshTopoChanged, nullptr, &status);
 			if (M_OK2)
-				addCallback(name + "TopoChanged", id);
+				dagCallbacks.push_back({ CB_TOPO_CHANGED, id });
 
 			id = MNodeMessage::addAttributeChangedCallback(node, meshAttributeChanged, nullptr, &status);
 			if (M_OK2)
-				addCallback(name + "AttriChanged", id);
+				dagCallbacks.push_back({ CB_MESH_ATTRIBUTE, id });
 
-			MCallbackId id = MNodeMessage::addAttributeChangedCallback(node, meshSetMaterial, nullptr, &status);
+			id = MNodeMessage::addAttributeChangedCallback(node, meshSetMaterial, nullptr, &status);
 			if (M_OK2)
-				addCallback(name + "MeshMatAttriChanged", id);
+				dagCallbacks.push_back({ CB_MESH_MATERIAL, id });
 		}
 
 		if (node.hasFn(MFn::kTransform))
 		{
 			id = MNodeMessage::addAttributeChangedCallback(node, transformAttributeChanged, NULL, &status);
 			if (M_OK2)
-				addCallback(name + "TranformChanged", id);
+				dagCallbacks.push_back({ CB_TRANSFORM, id });
 		}
 
 	}
@@ -461,20 +983,26 @@ void nodeAdded(MObject& node, void* clientData)
 	if (M_OK2)
 	{
 		MCallbackId id;
-		std::string name = dgNode.name().asChar();
 
 		if (node.hasFn(MFn::kLambert))
 		{
 			id = MNodeMessage::addAttributeChangedCallback(node, materialAttributeChanged, NULL, &status);
 			if (M_OK2)
-				addCallback(name + "MaterialChanged", id);
+				addCallback(node, CB_MATERIAL, id);
 		}
 
 		if (node.hasFn(MFn::kFileTexture))
 		{
 			id = MNodeMessage::addAttributeChangedCallback(node, fileTextureAttributeChanged, nullptr, &status);
 			if (M_OK2)
-				addCallbackDelOld(name + "FileTextureChanged", id);
+				replaceCallback(node, CB_FILE_TEXTURE, id);
+		}
+
+		if (node.hasFn(MFn::kSkinClusterFilter))
+		{
+			id = MNodeMessage::addAttributeChangedCallback(node, skinClusterAttributeChanged, nullptr, &status);
+			if (M_OK2)
+				replaceCallback(node, CB_SKIN_CLUSTER, id);
 		}
 	}
 }
@@ -497,6 +1025,8 @@ EXPORT MStatus initializePlugin(MObject obj) {
 
 	producerBuffer = new Comlib(L"Filemap", 150, ProcessType::Producer);
 
+	// Packing & sending from here on happen on the export worker
+	exportWorker().start();
 
 	iterateScene();
 
@@ -505,29 +1035,58 @@ EXPORT MStatus initializePlugin(MObject obj) {
 
 	callbackId = MDGMessage::addNodeAddedCallback(nodeAdded, "dependNode", NULL, &status);
 	if (M_OK2)
-		callbacks.insert({ "nodeCreationCB", callbackId });
+		globalCallbacks.append(callbackId);
 
 	callbackId = MDGMessage::addNodeRemovedCallback(nodeRemoved, "dependNode", nullptr, &status);
 	if (M_OK2)
-		callbacks.insert({ "nodeRemovedCB", callbackId });
+		globalCallbacks.append(callbackId);
+
+	callbackId = MDGMessage::addTimeChangeCallback(timeChanged, nullptr, &status);
+	if (M_OK2)
+		globalCallbacks.append(callbackId);
+
+	callbackId = MAnimMessage::addAnimCurveEditedCallback(animCurveEdited, nullptr, &status);
+	if (M_OK2)
+		globalCallbacks.append(callbackId);
+
+	callbackId = MDagMessage::addParentAddedCallback(parentAdded, nullptr, &status);
+	if (M_OK2)
+		globalCallbacks.append(callbackId);
 
 	// Cameras
+	panelFocusChanged(nullptr);
+
+	callbackId = MEventMessage::addEventCallback("ModelPanelSetFocus", panelFocusChanged, nullptr, &status);
+	if (M_OK2)
+		globalCallbacks.append(callbackId);
+
 	callbackId = MUiMessage::add3dViewPreRenderMsgCallback("modelPanel1", cameraMoved);
 	if (M_OK2)
-		callbacks.insert({ "cameraPanel1", callbackId });
+		globalCallbacks.append(callbackId);
 
 	callbackId = MUiMessage::add3dViewPreRenderMsgCallback("modelPanel2", cameraMoved);
 	if (M_OK2)
-		callbacks.insert({ "cameraPanel2", callbackId });
+		globalCallbacks.append(callbackId);
 
 	callbackId = MUiMessage::add3dViewPreRenderMsgCallback("modelPanel3", cameraMoved);
 	if (M_OK2)
-		callbacks.insert({ "cameraPanel3", callbackId });
+		globalCallbacks.append(callbackId);
 
 	callbackId = MUiMessage::add3dViewPreRenderMsgCallback("modelPanel4", cameraMoved);
 	if (M_OK2)
-		callbacks.insert({ "cameraPanel4", callbackId });
+		globalCallbacks.append(callbackId);
 
+	// Profiling
+	res = myPlugin.registerCommand("exportStats", ExportStatsCommand::creator);
+	CHECK_MSTATUS(res);
+
+	const MString traceDir = MGlobal::executeCommandStringResult("internalVar -userTmpDir");
+	if (exportProfiler().startTrace((traceDir + "exportTrace.csv").asChar()))
+	{
+		callbackId = MTimerMessage::addTimerCallback(TRACE_PERIOD, writeProfilerTrace, nullptr, &status);
+		if (M_OK2)
+			globalCallbacks.append(callbackId);
+	}
 
 	return res;
 }
@@ -536,11 +1095,31 @@ EXPORT MStatus uninitializePlugin(MObject obj)
 {
 	MFnPlugin plugin(obj);
 
-	for (auto& id : callbacks)
+	for (auto& node : nodeCallbacks)
+	{
+		for (const NodeCallback& callback : node.second)
+			MMessage::removeCallback(callback.id);
+	}
+	nodeCallbacks.clear();
+
+	MMessage::removeCallbacks(globalCallbacks);
+	plugin.deregisterCommand("exportStats");
+
+	if (timeChangeIdleId)
 	{
-		MMessage::removeCallback(id.second);
+		MMessage::removeCallback(timeChangeIdleId);
+		timeChangeIdleId = 0;
 	}
 
+	// Sends whatever is still queued before the buffer goes away
+	exportWorker().stop();
+	exportProfiler().writeTrace();
+
+	geometryCache.clear();
+	clippedTransforms.clear();
+	skinnedMeshes.clear();
+	sentMaterials.clear();
+
 	delete producerBuffer;
 
 	std::cout << "Plugin unloaded\n"
@@ -0,0 +1,226 @@
+#pragma once
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "Comlib.h"
+
+/*
+	Export profiler, tells whether Maya stalls come from extraction, packing or Comlib::Send.
+	Scopes record call counts and durations, messages record payload bytes and drops per message type.
+	Packing runs on the WorkerPool and the ExportWorker, so everything is behind one mutex.
+	Scope names are expected to be string literals (or __FUNCTION__), they are keyed by pointer.
+*/
+class ExportProfiler
+{
+public:
+	// Durations kept per scope for the percentiles, the oldest are overwritten
+	static const size_t MAX_SAMPLES = 4096;
+
+	void addTime(const char* scope, float milliseconds)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		ScopeStats& stats = scopes[scope];
+		stats.count++;
+		stats.total += milliseconds;
+		stats.max = std::max(stats.max, milliseconds);
+
+		if (stats.samples.size() < MAX_SAMPLES)
+			stats.samples.push_back(milliseconds);
+		else
+			stats.samples[stats.count % MAX_SAMPLES] = milliseconds;
+	}
+
+	void addMessage(Headers header, size_t bytes, bool sent)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		MessageStats& stats = messages[header];
+		stats.count++;
+		stats.bytes += bytes + sizeof(SectionHeader);
+		if (!sent)
+			stats.drops++;
+	}
+
+	void reset()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		scopes.clear();
+		messages.clear();
+	}
+
+	std::string report() const
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		char line[256];
+		std::string result;
+
+		snprintf(line, sizeof(line), "%-32s %8s %10s %8s %8s %8s %8s\n", "scope", "calls", "total ms", "p50", "p95", "p99", "max");
+		result += line;
+
+		for (const auto& scope : sortedScopes())
+		{
+			const ScopeStats& stats = *scope.second;
+			snprintf(line, sizeof(line), "%-32s %8llu %10.2f %8.3f %8.3f %8.3f %8.3f\n", scope.first, (unsigned long long)stats.count,
+				stats.total, percentile(stats, 0.5f), percentile(stats, 0.95f), percentile(stats, 0.99f), stats.max);
+			result += line;
+		}
+
+		snprintf(line, sizeof(line), "\n%-32s %8s %14s %8s\n", "message", "count", "bytes", "drops");
+		result += line;
+
+		for (const auto& message : messages)
+		{
+			snprintf(line, sizeof(line), "%-32s %8llu %14llu %8llu\n", headerName(message.first), (unsigned long long)message.second.count,
+				(unsigned long long)message.second.bytes, (unsigned long long)message.second.drops);
+			result += line;
+		}
+
+		return result;
+	}
+
+	// Truncates the trace file, later writeTrace calls append one snapshot each
+	bool startTrace(const std::string& path)
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		tracePath = path;
+		traceStart = std::chrono::steady_clock::now();
+
+		std::ofstream file(tracePath, std::ios::trunc);
+		file << "seconds,kind,name,count,total,p50,p95,p99,max,drops\n";
+		return file.good();
+	}
+
+	// Appends the running totals as CSV, rows of the same snapshot share the seconds column
+	bool writeTrace()
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+
+		if (tracePath.empty())
+			return false;
+
+		std::ofstream file(tracePath, std::ios::app);
+		if (!file)
+			return false;
+
+		const float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - traceStart).count();
+
+		for (const auto& scope : sortedScopes())
+		{
+			const ScopeStats& stats = *scope.second;
+			file << seconds << ",scope," << scope.first << ',' << stats.count << ',' << stats.total << ','
+				<< percentile(stats, 0.5f) << ',' << percentile(stats, 0.95f) << ',' << percentile(stats, 0.99f) << ','
+				<< stats.max << ",0\n";
+		}
+
+		for (const auto& message : messages)
+		{
+			file << seconds << ",message," << headerName(message.first) << ',' << message.second.count << ','
+				<< message.second.bytes << ",0,0,0,0," << message.second.drops << '\n';
+		}
+
+		return file.good();
+	}
+
+	static const char* headerName(Headers header)
+	{
+		switch (header)
+		{
+		case MESH_NEW:			return "MESH_NEW";
+		case MESH_UPDATE:		return "MESH_UPDATE";
+		case TRANSFORM_DATA:	return "TRANSFORM_DATA";
+		case MATERIAL_DELTA:	return "MATERIAL_DELTA";
+		case CAMERA_DATA:		return "CAMERA_DATA";
+		case NODE_DELETE:		return "NODE_DELETE";
+		case NAME_CHANGE:		return "NAME_CHANGE";
+		case MESH_MATERIAL:		return "MESH_MATERIAL";
+		case MESH_INSTANCE:		return "MESH_INSTANCE";
+		case ANIMATION_CLIP:	return "ANIMATION_CLIP";
+		case TIME_SYNC:			return "TIME_SYNC";
+		case SKIN_DATA:			return "SKIN_DATA";
+		case JOINT_MATRICES:	return "JOINT_MATRICES";
+		case MESH_CHUNK:		return "MESH_CHUNK";
+		default:				return "INVALID";
+		}
+	}
+
+private:
+	struct ScopeStats
+	{
+		uint64_t count = 0;
+		float total = 0.f;
+		float max = 0.f;
+		std::vector<float> samples;
+	};
+
+	struct MessageStats
+	{
+		uint64_t count = 0;
+		uint64_t bytes = 0;
+		uint64_t drops = 0;
+	};
+
+	static float percentile(const ScopeStats& stats, float fraction)
+	{
+		if (stats.samples.empty())
+			return 0.f;
+
+		std::vector<float> sorted = stats.samples;
+		const size_t index = std::min(sorted.size() - 1, (size_t)(fraction * sorted.size()));
+		std::nth_element(sorted.begin(), sorted.begin() + index, sorted.end());
+		return sorted[index];
+	}
+
+	// Most total time first
+	std::vector<std::pair<const char*, const ScopeStats*>> sortedScopes() const
+	{
+		std::vector<std::pair<const char*, const ScopeStats*>> sorted;
+		for (const auto& scope : scopes)
+			sorted.emplace_back(scope.first, &scope.second);
+
+		std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second->total > b.second->total; });
+		return sorted;
+	}
+
+	mutable std::mutex mutex;
+	std::unordered_map<const char*, ScopeStats> scopes;
+	std::unordered_map<Headers, MessageStats> messages;
+
+	std::string tracePath;
+	std::chrono::steady_clock::time_point traceStart;
+};
+
+inline ExportProfiler& exportProfiler()
+{
+	static ExportProfiler profiler;
+	return profiler;
+}
+
+// Adds the time until the end of the enclosing scope to the profiler
+class ScopedTimer
+{
+public:
+	ScopedTimer(const char* scope)
+		:scope(scope), start(std::chrono::steady_clock::now())
+	{
+	}
+
+	~ScopedTimer()
+	{
+		exportProfiler().addTime(scope, std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count());
+	}
+
+private:
+	const char* scope;
+	std::chrono::steady_clock::time_point start;
+};
+
+#define PROFILE_FUNCTION() ScopedTimer functionTimer(__FUNCTION__)
@@ -1,263 +1,990 @@
 #pragma once
 
+#include <vector>
+#include <thread>
+#include <unordered_map>
 #include "Comlib.h"
-
-inline bool sendMesh(const MObject& node, Comlib* pComlib)
+#include "Packing.h"
+#include "ExportWorker.h"
+
+/*
+	Vertex layout written by sendMesh & sendUpdateMesh.
+	VERTEX_FULL keeps unquantized float positions.
+	VERTEX_RAW skips Maya's normals, tangents & binormals, the viewer rebuilds them (smooth, ignores hard edges).
+*/
+constexpr VertexLayout MESH_VERTEX_LAYOUT = VERTEX_PACKED;
+
+/*
+	Progressive streaming of large meshes.
+	Meshes with at least PROXY_MIN_VERTICES face-vertices are first sent as a coarse proxy (see buildProxyMesh),
+	messages larger than MESH_CHUNK_BYTES are split into MESH_CHUNKs the viewer reassembles and swaps in.
+*/
+constexpr unsigned int PROXY_MIN_VERTICES = 200000;
+constexpr unsigned int PROXY_GRID_RESOLUTION = 64;
+constexpr size_t MESH_CHUNK_BYTES = 8 * MB;
+
+inline bool getMeshBounds(const MFnMesh& mesh, MeshInfoHeader& meshHeader)
 {
-	
-	/*
-		To avoid unnecessary allocations,
-		such as dynamially allocating a Vertex- and int- array,
-		and then copying the data from the arrays to pMessage (the memory which Comlib will send).
-		We simply first allocate the total bytes needed,
-		and then cast & offset the pointer to whichever type we're using.
-		This way we can directly write to the memory that the Comlib will copy and send.
-
-		The memory allocated is being used according to the following structure:
-		MeshInfoHeader
-		Vertex (all vertices)
-		int (all indices)
-	*/
+	MFloatPointArray points;
+	if (M_FAIL(mesh.getPoints(points)))
+		return false;
 
-	MStatus status;
+	for (int k = 0; k < 3; k++)
+	{
+		meshHeader.boundsMin[k] = 0.f;
+		meshHeader.boundsMax[k] = 0.f;
+	}
 
-	MFnMesh mesh(node, &status);
-	if (M_FAIL(status))
-		return false;
+	for (unsigned int i = 0; i < points.length(); i++)
+	{
+		for (int k = 0; k < 3; k++)
+		{
+			if (i == 0 || points[i][k] < meshHeader.boundsMin[k])
+				meshHeader.boundsMin[k] = points[i][k];
+			if (i == 0 || points[i][k] > meshHeader.boundsMax[k])
+				meshHeader.boundsMax[k] = points[i][k];
+		}
+	}
 
+	return true;
+}
+
+/*
+	Plain copy of a mesh's per face-vertex data.
+	Gathering needs the Maya API and has to run on the main thread,
+	packing only reads this struct and can run on any thread.
+*/
+struct MeshData
+{
 	// MFnTransform name is used in Gameplay3D
-	MFnDagNode dag(mesh.parent(0), &status);
-	if (M_FAIL(status))
-		return false;
+	std::string name;
+	MeshInfoHeader info;
+
+	std::vector<float> positions;	// xyz
+	std::vector<float> uvs;			// uv
+	std::vector<float> normals;		// xyz
+	std::vector<float> tangents;	// xyz
+	std::vector<float> biNormals;	// xyz
+	std::vector<int> indices;
+
+	// Maya vertex of each face-vertex
+	std::vector<int> vertexIds;
+
+	// VERTEX_SKINNED only, 4 per vertex
+	std::vector<float> blendWeights;
+	std::vector<float> blendIndices;
 
-	const char* nodeName = dag.name(&status).asChar();
+	// Roughly what the arrays hold on to
+	size_t bytes() const
+	{
+		const size_t floats = positions.size() + uvs.size() + normals.size() + tangents.size() + biNormals.size() + blendWeights.size() + blendIndices.size();
+		return floats * sizeof(float) + (indices.size() + vertexIds.size()) * sizeof(int);
+	}
+};
+
+// Reads the face-vertex data of a mesh shape or mesh data object
+inline bool gatherGeometry(const MObject& geometry, MeshData& data, VertexLayout layout = MESH_VERTEX_LAYOUT)
+{
+	PROFILE_FUNCTION();
+
+	MStatus status;
+
+	MFnMesh mesh(geometry, &status);
 	if (M_FAIL(status))
 		return false;
 
-	MItMeshFaceVertex vertexIterator(node, &status);
+	MItMeshFaceVertex vertexIterator(geometry, &status);
 	if (M_FAIL(status))
 		return false;
 
-
 	MIntArray xTrianglesPerFace, index;
-	MFloatVectorArray tangents, biNormals;
-	MStatus triStatus = mesh.getTriangleOffsets(xTrianglesPerFace, index);
-	MStatus tangStatus = mesh.getTangents(tangents);
-	MStatus biNormStatus = mesh.getBinormals(biNormals);
-
-	if (M_FAIL(triStatus) || M_FAIL(tangStatus) || M_FAIL(biNormStatus))
+	if (M_FAIL(mesh.getTriangleOffsets(xTrianglesPerFace, index)))
 		return false;
 
+	// getTangents & getBinormals are the slow part of gathering
+	const bool derived = layout != VERTEX_RAW;
 
+	MFloatVectorArray tangents, biNormals;
+	if (derived && (M_FAIL(mesh.getTangents(tangents)) || M_FAIL(mesh.getBinormals(biNormals))))
+		return false;
 
-	MeshInfoHeader meshHeader{ 0, index.length() };
+	data.info = { 0, index.length(), layout };
 	for (; !vertexIterator.isDone(); vertexIterator.next())
-		meshHeader.numVertex++;
+		data.info.numVertex++;
 
-	const size_t SIZE = sizeof(MeshInfoHeader) + sizeof(Vertex) * meshHeader.numVertex + sizeof(int) * meshHeader.numIndex;
-	char* pMessage = (char*)malloc(SIZE);
-	if (!pMessage)
+	if (!getMeshBounds(mesh, data.info))
 		return false;
 
-	size_t offset = 0, numBytes = SIZE - (sizeof(Vertex) * meshHeader.numVertex + sizeof(int) * meshHeader.numIndex);
-	memcpy(pMessage, &meshHeader, numBytes);
-	offset += sizeof(MeshInfoHeader);
+	const unsigned int numVertex = data.info.numVertex;
+	data.positions.resize(numVertex * 3);
+	data.uvs.resize(numVertex * 2);
+	data.normals.resize(derived ? numVertex * 3 : 0);
+	data.tangents.resize(derived ? numVertex * 3 : 0);
+	data.biNormals.resize(derived ? numVertex * 3 : 0);
+	data.vertexIds.resize(numVertex);
 
 	MPoint position;
 	float2 uv;
 	MVector normal;
-	Vertex* pVertex = (Vertex*)(pMessage + offset);
 
 	vertexIterator.reset();
-	for (int i = 0; !vertexIterator.isDone(); vertexIterator.next(), i++)
+	for (unsigned int i = 0; !vertexIterator.isDone(); vertexIterator.next(), i++)
 	{
 		position = vertexIterator.position();
 		vertexIterator.getUV(uv);
+
+		data.positions[i * 3 + 0] = (float)position.x;
+		data.positions[i * 3 + 1] = (float)position.y;
+		data.positions[i * 3 + 2] = (float)position.z;
+
+		data.uvs[i * 2 + 0] = uv[0];
+		data.uvs[i * 2 + 1] = uv[1];
+
+		data.vertexIds[i] = vertexIterator.vertId();
+
+		if (!derived)
+			continue;
+
 		vertexIterator.getNormal(normal);
 
-		pVertex[i].position[0] = (float)position.x;
-		pVertex[i].position[1] = (float)position.y;
-		pVertex[i].position[2] = (float)position.z;
+		data.normals[i * 3 + 0] = (float)normal.x;
+		data.normals[i * 3 + 1] = (float)normal.y;
+		data.normals[i * 3 + 2] = (float)normal.z;
+
+		data.tangents[i * 3 + 0] = tangents[i].x;
+		data.tangents[i * 3 + 1] = tangents[i].y;
+		data.tangents[i * 3 + 2] = tangents[i].z;
+
+		data.biNormals[i * 3 + 0] = biNormals[i].x;
+		data.biNormals[i * 3 + 1] = biNormals[i].y;
+		data.biNormals[i * 3 + 2] = biNormals[i].z;
+	}
+
+	data.indices.resize(index.length());
+	if (index.length())
+		index.get(data.indices.data());
+
+	return true;
+}
+
+inline bool gatherMesh(const MObject& node, MeshData& data)
+{
+	MStatus status;
+
+	MFnMesh mesh(node, &status);
+	if (M_FAIL(status))
+		return false;
+
+	MFnDagNode dag(mesh.parent(0), &status);
+	if (M_FAIL(status))
+		return false;
+
+	data.name = dag.name(&status).asChar();
+	if (M_FAIL(status))
+		return false;
+
+	return gatherGeometry(node, data);
+}
+
+inline void writeVertices(const MeshData& data, char* pDest)
+{
+	const MeshInfoHeader& info = data.info;
+
+	if (info.layout == VERTEX_PACKED)
+	{
+		float invExtent[3];
+		for (int k = 0; k < 3; k++)
+		{
+			const float extent = info.boundsMax[k] - info.boundsMin[k];
+			invExtent[k] = extent > 0.f ? 1.f / extent : 0.f;
+		}
+
+		PackedVertex* pVertex = (PackedVertex*)pDest;
+		for (unsigned int i = 0; i < info.numVertex; i++)
+		{
+			const float* position = &data.positions[i * 3];
+			const float* normal = &data.normals[i * 3];
+			const float* tangent = &data.tangents[i * 3];
+			const float* biNormal = &data.biNormals[i * 3];
+
+			for (int k = 0; k < 3; k++)
+				pVertex[i].position[k] = toUnorm16((position[k] - info.boundsMin[k]) * invExtent[k]);
+
+			// Handedness of the tangent frame, the binormal itself is rebuilt in the shader
+			const float handedness =
+				(normal[1] * tangent[2] - normal[2] * tangent[1]) * biNormal[0] +
+				(normal[2] * tangent[0] - normal[0] * tangent[2]) * biNormal[1] +
+				(normal[0] * tangent[1] - normal[1] * tangent[0]) * biNormal[2];
+			pVertex[i].position[3] = handedness < 0.f ? 0 : 0xffff;
+
+			pVertex[i].uv[0] = floatToHalf(data.uvs[i * 2 + 0]);
+			pVertex[i].uv[1] = floatToHalf(data.uvs[i * 2 + 1]);
+
+			encodeOctahedral(normal[0], normal[1], normal[2], pVertex[i].normal);
+			encodeOctahedral(tangent[0], tangent[1], tangent[2], pVertex[i].tangent);
+		}
+
+		return;
+	}
+
+	if (info.layout == VERTEX_RAW)
+	{
+		RawVertex* pVertex = (RawVertex*)pDest;
+		for (unsigned int i = 0; i < info.numVertex; i++)
+		{
+			memcpy(pVertex[i].position, &data.positions[i * 3], sizeof(float) * 3);
+			memcpy(pVertex[i].uv, &data.uvs[i * 2], sizeof(float) * 2);
+			pVertex[i].vertexId = data.vertexIds[i];
+		}
 
-		pVertex[i].uv[0] = uv[0];
-		pVertex[i].uv[1] = uv[1];
+		return;
+	}
 
-		pVertex[i].normal[0] = (float)normal.x;
-		pVertex[i].normal[1] = (float)normal.y;
-		pVertex[i].normal[2] = (float)normal.z;
+	if (info.layout == VERTEX_SKINNED)
+	{
+		SkinnedVertex* pVertex = (SkinnedVertex*)pDest;
+		for (unsigned int i = 0; i < info.numVertex; i++)
+		{
+			memcpy(pVertex[i].vertex.position, &data.positions[i * 3], sizeof(float) * 3);
+			memcpy(pVertex[i].vertex.uv, &data.uvs[i * 2], sizeof(float) * 2);
+			memcpy(pVertex[i].vertex.normal, &data.normals[i * 3], sizeof(float) * 3);
+			memcpy(pVertex[i].vertex.tangent, &data.tangents[i * 3], sizeof(float) * 3);
+			memcpy(pVertex[i].vertex.biNormal, &data.biNormals[i * 3], sizeof(float) * 3);
+			memcpy(pVertex[i].blendWeights, &data.blendWeights[i * 4], sizeof(float) * 4);
+			memcpy(pVertex[i].blendIndices, &data.blendIndices[i * 4], sizeof(float) * 4);
+		}
 
-		pVertex[i].tangent[0] = tangents[i].x;
-		pVertex[i].tangent[1] = tangents[i].y;
-		pVertex[i].tangent[2] = tangents[i].z;
+		return;
+	}
 
-		pVertex[i].biNormal[0] = biNormals[i].x;
-		pVertex[i].biNormal[1] = biNormals[i].y;
-		pVertex[i].biNormal[2] = biNormals[i].z;
+	Vertex* pVertex = (Vertex*)pDest;
+	for (unsigned int i = 0; i < info.numVertex; i++)
+	{
+		memcpy(pVertex[i].position, &data.positions[i * 3], sizeof(float) * 3);
+		memcpy(pVertex[i].uv, &data.uvs[i * 2], sizeof(float) * 2);
+		memcpy(pVertex[i].normal, &data.normals[i * 3], sizeof(float) * 3);
+		memcpy(pVertex[i].tangent, &data.tangents[i * 3], sizeof(float) * 3);
+		memcpy(pVertex[i].biNormal, &data.biNormals[i * 3], sizeof(float) * 3);
 	}
+}
 
-	offset += sizeof(Vertex) * meshHeader.numVertex;
-	index.get((int*)(pMessage + offset));
+inline char* packMesh(const MeshData& data, size_t& size)
+{
+	PROFILE_FUNCTION();
 
+	/*
+		Doesn't touch the Maya API, safe to call from worker threads.
+		The returned memory is malloc'd and is laid out as:
+		MeshInfoHeader
+		Vertex, PackedVertex, SkinnedVertex or RawVertex (all vertices, see MeshInfoHeader::layout)
+		int (all indices)
+		MeshInfoHeader::geometryHash is filled in last, from everything else in the message.
+	*/
+
+	const size_t VERTEX_BYTES = vertexSize(data.info.layout) * data.info.numVertex;
+	const size_t INDEX_BYTES = sizeof(int) * data.info.numIndex;
+
+	size = sizeof(MeshInfoHeader) + VERTEX_BYTES + INDEX_BYTES;
+	char* pMessage = (char*)malloc(size);
+	if (!pMessage)
+		return nullptr;
+
+	// Written field by field so the padding is zeroed and doesn't affect the hash
+	MeshInfoHeader* pInfo = (MeshInfoHeader*)pMessage;
+	memset(pInfo, 0, sizeof(MeshInfoHeader));
+	pInfo->numVertex = data.info.numVertex;
+	pInfo->numIndex = data.info.numIndex;
+	pInfo->layout = data.info.layout;
+	memcpy(pInfo->boundsMin, data.info.boundsMin, sizeof(float) * 3);
+	memcpy(pInfo->boundsMax, data.info.boundsMax, sizeof(float) * 3);
+
+	writeVertices(data, pMessage + sizeof(MeshInfoHeader));
+	memcpy(pMessage + sizeof(MeshInfoHeader) + VERTEX_BYTES, data.indices.data(), INDEX_BYTES);
+
+	pInfo->geometryHash = hashBytes(pMessage, size);
+
+	return pMessage;
+}
+
+/*
+	Coarse stand-in for a large mesh, made by vertex clustering.
+	Positions snap to a PROXY_GRID_RESOLUTION grid over the bounds, each occupied cell becomes one vertex
+	(averaged position & normal, the rest from its first face-vertex) and triangles collapsing inside a cell are dropped.
+	Returns false for meshes small enough to send as they are.
+*/
+inline bool buildProxyMesh(const MeshData& data, MeshData& proxy)
+{
+	PROFILE_FUNCTION();
+
+	const MeshInfoHeader& info = data.info;
+	if (info.numVertex < PROXY_MIN_VERTICES || info.layout == VERTEX_SKINNED)
+		return false;
+
+	float cellSize = 0.f;
+	for (int k = 0; k < 3; k++)
+		cellSize = std::max(cellSize, (info.boundsMax[k] - info.boundsMin[k]) / PROXY_GRID_RESOLUTION);
+
+	if (cellSize <= 0.f)
+		return false;
+
+	const float invCellSize = 1.f / cellSize;
+	const bool derived = !data.normals.empty();
+
+	std::unordered_map<uint64_t, int> cells;
+	std::vector<int> remap(info.numVertex);
+	std::vector<unsigned int> counts;
+
+	for (unsigned int i = 0; i < info.numVertex; i++)
+	{
+		const float* position = &data.positions[i * 3];
+
+		uint64_t key = 0;
+		for (int k = 0; k < 3; k++)
+		{
+			const int cell = std::min((int)PROXY_GRID_RESOLUTION - 1, (int)((position[k] - info.boundsMin[k]) * invCellSize));
+			key = key * PROXY_GRID_RESOLUTION + (uint64_t)std::max(cell, 0);
+		}
+
+		auto inserted = cells.emplace(key, (int)counts.size());
+		const int cluster = inserted.first->second;
+		if (inserted.second)
+		{
+			counts.push_back(0);
+			proxy.positions.insert(proxy.positions.end(), 3, 0.f);
+			proxy.uvs.insert(proxy.uvs.end(), &data.uvs[i * 2], &data.uvs[i * 2] + 2);
+			proxy.vertexIds.push_back(cluster);
+
+			if (derived)
+			{
+				proxy.normals.insert(proxy.normals.end(), 3, 0.f);
+				proxy.tangents.insert(proxy.tangents.end(), &data.tangents[i * 3], &data.tangents[i * 3] + 3);
+				proxy.biNormals.insert(proxy.biNormals.end(), &data.biNormals[i * 3], &data.biNormals[i * 3] + 3);
+			}
+		}
+
+		remap[i] = cluster;
+		counts[cluster]++;
+
+		for (int k = 0; k < 3; k++)
+		{
+			proxy.positions[cluster * 3 + k] += position[k];
+			if (derived)
+				proxy.normals[cluster * 3 + k] += data.normals[i * 3 + k];
+		}
+	}
+
+	for (size_t i = 0; i < counts.size(); i++)
+	{
+		for (int k = 0; k < 3; k++)
+			proxy.positions[i * 3 + k] /= (float)counts[i];
+
+		if (!derived)
+			continue;
+
+		float* normal = &proxy.normals[i * 3];
+		const float length = std::sqrt(normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2]);
+		for (int k = 0; length > 0.f && k < 3; k++)
+			normal[k] /= length;
+	}
+
+	for (unsigned int i = 0; i + 2 < info.numIndex; i += 3)
+	{
+		const int a = remap[data.indices[i + 0]];
+		const int b = remap[data.indices[i + 1]];
+		const int c = remap[data.indices[i + 2]];
+
+		if (a != b && b != c && a != c)
+			proxy.indices.insert(proxy.indices.end(), { a, b, c });
+	}
+
+	proxy.name = data.name;
+	proxy.info = info;
+	proxy.info.numVertex = (unsigned int)counts.size();
+	proxy.info.numIndex = (unsigned int)proxy.indices.size();
+
+	return !proxy.indices.empty();
+}
+
+/*
+	Keeps track of which geometry Gameplay3D currently has, by MeshInfoHeader::geometryHash.
+	Mirrors the viewer's side: every node uses one hash, a hash stays alive while any node uses it.
+*/
+class GeometryCache
+{
+public:
+	// Makes name a user of hash, returns true if another node already uses the same geometry
+	bool acquire(const std::string& name, uint64_t hash)
+	{
+		auto nodeIt = nodeHashes.find(name);
+		if (nodeIt != nodeHashes.end() && nodeIt->second == hash)
+			return false;
+
+		release(name);
+
+		const bool shared = users[hash]++ > 0;
+		nodeHashes[name] = hash;
+
+		return shared;
+	}
+
+	void release(const std::string& name)
+	{
+		auto nodeIt = nodeHashes.find(name);
+		if (nodeIt == nodeHashes.end())
+			return;
+
+		auto userIt = users.find(nodeIt->second);
+		if (userIt != users.end() && --userIt->second == 0)
+			users.erase(userIt);
+
+		nodeHashes.erase(nodeIt);
+	}
+
+	void rename(const std::string& oldName, const std::string& newName)
+	{
+		auto nodeIt = nodeHashes.find(oldName);
+		if (nodeIt == nodeHashes.end())
+			return;
+
+		const uint64_t hash = nodeIt->second;
+		nodeHashes.erase(nodeIt);
+		nodeHashes[newName] = hash;
+	}
+
+	void clear()
+	{
+		users.clear();
+		nodeHashes.clear();
+	}
+
+private:
+	std::unordered_map<uint64_t, unsigned int> users;
+	std::unordered_map<std::string, uint64_t> nodeHashes;
+};
+
+// Sends a message too large for one ring slot as MESH_CHUNKs, waiting for the viewer to make room as needed
+inline bool sendMeshChunks(Headers header, const CharString& name, const char* pMessage, size_t size, Comlib* pComlib)
+{
+	PROFILE_FUNCTION();
+
+	std::vector<char> chunk(sizeof(MeshChunkHeader) + MESH_CHUNK_BYTES);
+
+	for (size_t offset = 0; offset < size; offset += MESH_CHUNK_BYTES)
+	{
+		const size_t bytes = std::min(MESH_CHUNK_BYTES, size - offset);
+
+		MeshChunkHeader chunkHeader{ header, size, offset };
+		memcpy(chunk.data(), &chunkHeader, sizeof(MeshChunkHeader));
+		memcpy(chunk.data() + sizeof(MeshChunkHeader), pMessage + offset, bytes);
+
+		SectionHeader secHeader;
+		secHeader.name = name;
+		secHeader.header = MESH_CHUNK;
+		secHeader.messageLength = sizeof(MeshChunkHeader) + bytes;
+
+		// A dropped chunk would leave the whole mesh incomplete, sendMessage already retried it
+		if (!sendMessage(pComlib, chunk.data(), &secHeader))
+			return false;
+	}
+
+	return true;
+}
+
+// pProxy is an optional packed buildProxyMesh result, shown until the full mesh has arrived
+inline bool sendPackedMesh(Headers header, const std::string& name, char* pMessage, size_t size, Comlib* pComlib, GeometryCache* pCache = nullptr,
+	char* pProxy = nullptr, size_t proxySize = 0)
+{
+	PROFILE_FUNCTION();
 
 	SectionHeader secHeader;
-	secHeader.header = MESH_NEW;
-	secHeader.name = nodeName;
-	secHeader.messageLength = SIZE;
+	secHeader.name = name;
 
-	pComlib->Send(pMessage, &secHeader);
+	// Geometry that's already in Gameplay3D is only referenced
+	const uint64_t hash = ((MeshInfoHeader*)pMessage)->geometryHash;
+	if (pCache && pCache->acquire(name, hash))
+	{
+		MeshInstanceHeader instance{ hash };
 
-	free(pMessage);
+		secHeader.header = MESH_INSTANCE;
+		secHeader.messageLength = sizeof(MeshInstanceHeader);
+
+		return sendMessage(pComlib, (char*)&instance, &secHeader);
+	}
+
+	if (pProxy && header == MESH_NEW)
+	{
+		secHeader.header = MESH_NEW;
+		secHeader.messageLength = proxySize;
+		sendMessage(pComlib, pProxy, &secHeader);
+	}
+
+	if (size > MESH_CHUNK_BYTES)
+		return sendMeshChunks(header, secHeader.name, pMessage, size, pComlib);
+
+	secHeader.header = header;
+	secHeader.messageLength = size;
+
+	return sendMessage(pComlib, pMessage, &secHeader);
+}
+
+inline bool sendMesh(const MObject& node, Comlib* pComlib, GeometryCache* pCache = nullptr, Headers header = MESH_NEW)
+{
+	PROFILE_FUNCTION();
+
+	std::shared_ptr<MeshData> pData = std::make_shared<MeshData>();
+	if (!gatherMesh(node, *pData))
+		return false;
+
+	// Only gathering needs the main thread
+	runOnExportWorker([pData, pComlib, pCache, header]
+	{
+		size_t size = 0;
+		char* pMessage = packMesh(*pData, size);
+		if (!pMessage)
+			return;
+
+		MeshData proxy;
+		size_t proxySize = 0;
+		char* pProxy = header == MESH_NEW && buildProxyMesh(*pData, proxy) ? packMesh(proxy, proxySize) : nullptr;
+
+		sendPackedMesh(header, pData->name, pMessage, size, pComlib, pCache, pProxy, proxySize);
+
+		free(pMessage);
+		free(pProxy);
+	}, pData->bytes());
 
 	return true;
 }
 
-inline bool sendUpdateMesh(const MObject& node, Comlib* pComlib)
+inline bool sendUpdateMesh(const MObject& node, Comlib* pComlib, GeometryCache* pCache = nullptr)
+{
+	PROFILE_FUNCTION();
+
+	// Same data as sendMesh, Gameplay3D writes it into the existing buffers
+	return sendMesh(node, pComlib, pCache, MESH_UPDATE);
+}
+
+// Returns the skinCluster deforming a mesh shape, or a null object if it isn't skinned
+inline MObject findSkinCluster(const MObject& node)
 {
+	MStatus status;
+	MFnDependencyNode shape(node, &status);
+	if (M_FAIL(status))
+		return MObject::kNullObj;
+
+	MPlug inMesh = shape.findPlug("inMesh", true, &status);
+	if (M_FAIL(status))
+		return MObject::kNullObj;
+
+	MItDependencyGraph graphIterator(inMesh, MFn::kSkinClusterFilter, MItDependencyGraph::kUpstream,
+		MItDependencyGraph::kDepthFirst, MItDependencyGraph::kNodeLevel, &status);
+	if (M_FAIL(status))
+		return MObject::kNullObj;
+
+	// The first skinCluster upstream could belong to another mesh feeding this one
+	for (; !graphIterator.isDone(); graphIterator.next())
+	{
+		MObject skinCluster = graphIterator.currentItem();
+		MFnSkinCluster skin(skinCluster);
+		skin.indexForOutputShape(node, &status);
+		if (M_OK(status))
+			return skinCluster;
+	}
+
+	return MObject::kNullObj;
+}
+
+inline bool gatherSkinWeights(const MObject& node, const MFnSkinCluster& skin, MeshData& data)
+{
+	PROFILE_FUNCTION();
+
 	/*
-		This function differs from sendMesh.
-		Mostly by only sending MeshInfoHeader and vertices no indices.
+		Keeps the 4 strongest influences of every Maya vertex, renormalized,
+		then expands them to the face-vertices gathered in data.
 	*/
 
 	MStatus status;
-	MFnMesh mesh(node, &status);
+
+	MDagPath shapePath;
+	if (M_FAIL(MDagPath::getAPathTo(node, shapePath)))
+		return false;
+
+	MFnSingleIndexedComponent componentFn;
+	MObject components = componentFn.create(MFn::kMeshVertComponent, &status);
 	if (M_FAIL(status))
 		return false;
 
-	MFnTransform tra(mesh.parent(0), &status);
+	componentFn.setCompleteData(MFnMesh(shapePath).numVertices());
+
+	MFloatArray weights;
+	unsigned int numInfluences = 0;
+	if (M_FAIL(skin.getWeights(shapePath, components, weights, numInfluences)) || numInfluences == 0)
+		return false;
+
+	const unsigned int numMayaVertices = weights.length() / numInfluences;
+	std::vector<float> vertexWeights(numMayaVertices * 4, 0.f);
+	std::vector<float> vertexIndices(numMayaVertices * 4, 0.f);
+
+	for (unsigned int v = 0; v < numMayaVertices; v++)
+	{
+		float* pWeights = &vertexWeights[v * 4];
+		float* pIndices = &vertexIndices[v * 4];
+
+		for (unsigned int j = 0; j < numInfluences; j++)
+		{
+			const float weight = weights[v * numInfluences + j];
+			if (weight <= pWeights[3])
+				continue;
+
+			int slot = 3;
+			for (; slot > 0 && weight > pWeights[slot - 1]; slot--)
+			{
+				pWeights[slot] = pWeights[slot - 1];
+				pIndices[slot] = pIndices[slot - 1];
+			}
+
+			pWeights[slot] = weight;
+			pIndices[slot] = (float)j;
+		}
+
+		const float total = pWeights[0] + pWeights[1] + pWeights[2] + pWeights[3];
+		if (total > 0.f)
+		{
+			for (int k = 0; k < 4; k++)
+				pWeights[k] /= total;
+		}
+	}
+
+	const unsigned int numVertex = data.info.numVertex;
+	data.blendWeights.resize(numVertex * 4);
+	data.blendIndices.resize(numVertex * 4);
+
+	for (unsigned int i = 0; i < numVertex; i++)
+	{
+		const unsigned int v = (unsigned int)data.vertexIds[i];
+		if (v >= numMayaVertices)
+			return false;
+
+		memcpy(&data.blendWeights[i * 4], &vertexWeights[v * 4], sizeof(float) * 4);
+		memcpy(&data.blendIndices[i * 4], &vertexIndices[v * 4], sizeof(float) * 4);
+	}
+
+	return true;
+}
+
+inline bool sendSkinData(const std::string& name, const MFnSkinCluster& skin, Comlib* pComlib)
+{
+	PROFILE_FUNCTION();
+
+	MStatus status;
+
+	MDagPathArray influences;
+	const unsigned int numJoints = skin.influenceObjects(influences, &status);
 	if (M_FAIL(status))
 		return false;
 
-	// Gameplay3D uses transform name
-	const char* nodeName = tra.name(&status).asChar();
+	MPlug bindPreMatrix = skin.findPlug("bindPreMatrix", true, &status);
 	if (M_FAIL(status))
 		return false;
 
-	MItMeshFaceVertex vertexIterator(node, &status);
+	MPlug geomMatrix = skin.findPlug("geomMatrix", true, &status);
 	if (M_FAIL(status))
 		return false;
 
-	MIntArray xTrianglesPerFace, index;
-	MFloatVectorArray tangents, biNormals;
+	SkinDataHeader skinHeader{};
+	skinHeader.numJoints = numJoints;
+	MFnMatrixData(geomMatrix.asMObject()).matrix().get(skinHeader.bindShape);
 
-	MStatus triStatus = mesh.getTriangleOffsets(xTrianglesPerFace, index);
-	MStatus tangStatus = mesh.getTangents(tangents);
-	MStatus biNormStatus = mesh.getBinormals(biNormals);
+	const size_t size = sizeof(SkinDataHeader) + sizeof(float) * 16 * numJoints;
+	char* pMessage = (char*)malloc(size);
+	if (!pMessage)
+		return false;
+
+	memcpy(pMessage, &skinHeader, sizeof(SkinDataHeader));
+
+	// bindPreMatrix is indexed by the influence's logical index, not its position in influences
+	float (*pInverseBinds)[4][4] = (float(*)[4][4])(pMessage + sizeof(SkinDataHeader));
+	for (unsigned int i = 0; i < numJoints; i++)
+	{
+		const unsigned int index = skin.indexForInfluenceObject(influences[i]);
+		MFnMatrixData(bindPreMatrix.elementByLogicalIndex(index).asMObject()).matrix().get(pInverseBinds[i]);
+	}
+
+	SectionHeader secHeader;
+	secHeader.name = name;
+	secHeader.header = SKIN_DATA;
+	secHeader.messageLength = size;
+	sendMessage(pComlib, pMessage, &secHeader);
 
-	if (M_FAIL(triStatus) || M_FAIL(tangStatus) || M_FAIL(biNormStatus))
+	free(pMessage);
+
+	return true;
+}
+
+inline bool sendSkinnedMesh(const MObject& node, const MObject& skinCluster, Comlib* pComlib, GeometryCache* pCache = nullptr)
+{
+	PROFILE_FUNCTION();
+
+	/*
+		Sends the skinCluster's input (bind pose) geometry with joint weights, then the skin itself.
+		Gameplay3D deforms it on the GPU, after this only JOINT_MATRICES need to be sent.
+	*/
+
+	MStatus status;
+
+	MFnSkinCluster skin(skinCluster, &status);
+	if (M_FAIL(status))
 		return false;
 
-	MeshInfoHeader meshHeader{ 0, index.length() };
-	for (; !vertexIterator.isDone(); vertexIterator.next())
-		meshHeader.numVertex++;
+	std::shared_ptr<MeshData> pData = std::make_shared<MeshData>();
+	MeshData& data = *pData;
 
-	const size_t SIZE = sizeof(MeshInfoHeader) + sizeof(Vertex) * meshHeader.numVertex + sizeof(int) * meshHeader.numIndex;
-	char* pMessage = (char*)malloc(SIZE);
-	if (!pMessage)
+	MFnDagNode dag(MFnDagNode(node).parent(0), &status);
+	if (M_FAIL(status))
 		return false;
 
-	size_t offset = 0, numBytes = SIZE - (sizeof(Vertex) * meshHeader.numVertex + sizeof(int) * meshHeader.numIndex);
-	memcpy(pMessage, &meshHeader, numBytes);
-	offset += sizeof(MeshInfoHeader);
+	data.name = dag.name(&status).asChar();
+	if (M_FAIL(status))
+		return false;
 
-	MPoint position;
-	float2 uv;
-	MVector normal;
-	Vertex* pVertex = (Vertex*)(pMessage + offset);
+	const unsigned int index = skin.indexForOutputShape(node, &status);
+	if (M_FAIL(status))
+		return false;
 
-	vertexIterator.reset();
-	for (int i = 0; !vertexIterator.isDone(); vertexIterator.next(), i++)
+	MObject bindGeometry = skin.inputShapeAtIndex(index, &status);
+	if (M_FAIL(status) || !gatherGeometry(bindGeometry, data, VERTEX_SKINNED))
+		return false;
+
+	if (!gatherSkinWeights(node, skin, data))
+		return false;
+
+	runOnExportWorker([pData, pComlib, pCache]
 	{
-		position = vertexIterator.position();
-		vertexIterator.getUV(uv);
-		vertexIterator.getNormal(normal);
+		size_t size = 0;
+		char* pMessage = packMesh(*pData, size);
+		if (!pMessage)
+			return;
 
-		pVertex[i].position[0] = (float)position.x;
-		pVertex[i].position[1] = (float)position.y;
-		pVertex[i].position[2] = (float)position.z;
+		sendPackedMesh(MESH_NEW, pData->name, pMessage, size, pComlib, pCache);
 
-		pVertex[i].uv[0] = uv[0];
-		pVertex[i].uv[1] = uv[1];
+		free(pMessage);
+	}, pData->bytes());
 
-		pVertex[i].normal[0] = (float)normal.x;
-		pVertex[i].normal[1] = (float)normal.y;
-		pVertex[i].normal[2] = (float)normal.z;
+	// Queued after the mesh, so Gameplay3D has the model before its skin
+	return sendSkinData(data.name, skin, pComlib);
+}
 
-		pVertex[i].tangent[0] = tangents[i].x;
-		pVertex[i].tangent[1] = tangents[i].y;
-		pVertex[i].tangent[2] = tangents[i].z;
+// pLastSent belongs to the export worker, it's compared & updated there after the sends queued before it
+inline bool sendJointMatrices(const std::string& name, const MDagPathArray& influences, Comlib* pComlib,
+	std::shared_ptr<std::vector<float>> pLastSent = nullptr)
+{
+	PROFILE_FUNCTION();
 
-		pVertex[i].biNormal[0] = biNormals[i].x;
-		pVertex[i].biNormal[1] = biNormals[i].y;
-		pVertex[i].biNormal[2] = biNormals[i].z;
+	// Same order as the skin's influences, see sendSkinData
+	const unsigned int numJoints = influences.length();
+	std::vector<float> matrices(numJoints * 16);
+
+	float matrix[4][4];
+	for (unsigned int i = 0; i < numJoints; i++)
+	{
+		influences[i].inclusiveMatrix().get(matrix);
+		memcpy(&matrices[i * 16], matrix, sizeof(matrix));
 	}
 
-	offset += sizeof(Vertex) * meshHeader.numVertex;
-	index.get((int*)(pMessage + offset));
+	const size_t bytes = sizeof(float) * matrices.size();
+	runOnExportWorker([name, numJoints, matrices = std::move(matrices), pComlib, pLastSent]() mutable
+	{
+		// Nothing to do if none of the joints moved
+		if (pLastSent && *pLastSent == matrices)
+			return;
 
-	SectionHeader secHeader;
-	secHeader.header = MESH_UPDATE;
-	secHeader.name = nodeName;
-	secHeader.messageLength = SIZE;
+		JointMatricesHeader jointHeader{ numJoints };
 
-	pComlib->Send(pMessage, &secHeader);
+		const size_t size = sizeof(JointMatricesHeader) + sizeof(float) * matrices.size();
+		std::vector<char> message(size);
+		memcpy(message.data(), &jointHeader, sizeof(JointMatricesHeader));
+		memcpy(message.data() + sizeof(JointMatricesHeader), matrices.data(), sizeof(float) * matrices.size());
 
-	free(pMessage);
+		SectionHeader secHeader;
+		secHeader.name = name;
+		secHeader.header = JOINT_MATRICES;
+		secHeader.messageLength = size;
+
+		// A failed send leaves the cache as it was, the next call sends the pose again even if nothing moved
+		if (sendMessage(pComlib, message.data(), &secHeader) && pLastSent)
+			*pLastSent = std::move(matrices);
+	}, bytes);
 
 	return true;
 }
 
 inline bool SendTransformData(const MObject& obj, Comlib* pComlib)
 {
+	PROFILE_FUNCTION();
+
+	/*
+		Sends the local matrix along with the parent transform's name.
+		Gameplay3D mirrors the DAG hierarchy, so children don't need to be resent
+		when a parent moves, their world matrices are resolved on that side.
+	*/
+
 	MStatus status;
 	MFnTransform trans(obj, &status);
-	if (status == MS::kSuccess)
-	{
-		MFnDagNode dag(obj, &status);
-		if (M_FAIL(status))
-			return false;
+	if (M_FAIL(status))
+		return false;
 
-		std::string name = trans.name(&status).asChar();
-		if (M_FAIL(status))
-			return false;
+	std::string name = trans.name(&status).asChar();
+	if (M_FAIL(status))
+		return false;
 
-		MDagPath path;
-		status = dag.getPath(path);
-		if (M_FAIL(status))
-			return false;
+	TransformDataHeader transHeader{};
+	trans.transformationMatrix().get(transHeader.transMtrx);
+
+	// Top level transforms are parented to the world node, which isn't a transform
+	MObject parent = trans.parent(0, &status);
+	if (M_OK(status) && parent.hasFn(MFn::kTransform))
+		transHeader.parentName = MFnDagNode(parent).name().asChar();
+
+	SectionHeader secHeader;
+	secHeader.name = name;
+	secHeader.header = TRANSFORM_DATA;
+	secHeader.messageLength = sizeof(TransformDataHeader);
+	sendMessage(pComlib, (char*)&transHeader, &secHeader);
 
-		TransformDataHeader transHeader{};
-		path.inclusiveMatrix().get(transHeader.transMtrx);
+	return true;
+}
 
-		size_t transMsgLen = sizeof(TransformDataHeader) + 1;
-		char* msg = new char[transMsgLen];
-		size_t offset = 0;
+// Milliseconds from the start of the playback range, the time base of clips and TIME_SYNC
+inline float getClipTime(const MTime& time)
+{
+	return (float)(time - MAnimControl::minTime()).as(MTime::kMilliseconds);
+}
 
-		memcpy(msg + offset, &transHeader, sizeof(TransformDataHeader));
+inline bool sendAnimationClip(const MObject& obj, Comlib* pComlib)
+{
+	PROFILE_FUNCTION();
 
-		SectionHeader secHeader;
-		secHeader.name = name;
-		secHeader.header = TRANSFORM_DATA;
-		secHeader.messageLength = transMsgLen;
-		secHeader.messageID = 0;
-		pComlib->Send(msg, &secHeader);
+	/*
+		Samples the local matrix once per frame of the playback range.
+		Gameplay3D plays the keys back itself, only TIME_SYNC is sent per frame after this.
+		Transforms that are no longer animated get an empty clip, which removes it.
+	*/
 
-		delete[]msg;
-		for (unsigned int i = 0; i < dag.childCount(); i++)
+	MStatus status;
+	MFnTransform trans(obj, &status);
+	if (M_FAIL(status))
+		return false;
+
+	std::string name = trans.name(&status).asChar();
+	if (M_FAIL(status))
+		return false;
+
+	MPlug matrixPlug = trans.findPlug("matrix", true, &status);
+	if (M_FAIL(status))
+		return false;
+
+	std::vector<TransformKey> keys;
+	if (MAnimUtil::isAnimated(obj))
+	{
+		const MTime start = MAnimControl::minTime();
+		const MTime end = MAnimControl::maxTime();
+		const MTime step(1.0, MTime::uiUnit());
+
+		keys.reserve((size_t)((end - start).as(MTime::uiUnit())) + 1);
+
+		for (MTime time = start; time <= end; time += step)
 		{
-			if (!dag.child(i).isNull())
+			MDGContext context(time);
+			MDGContextGuard guard(context);
+
+			MFnMatrixData matrixData(matrixPlug.asMObject(), &status);
+			if (M_FAIL(status))
+				return false;
+
+			MTransformationMatrix transform(matrixData.matrix());
+
+			TransformKey key;
+			key.time = (unsigned int)(getClipTime(time) + 0.5f);
+
+			double scale[3];
+			transform.getScale(scale, MSpace::kTransform);
+			MQuaternion rotation = transform.rotation();
+			MVector translation = transform.getTranslation(MSpace::kTransform);
+
+			// Keep neighbouring quaternions in the same hemisphere so interpolation takes the short way
+			if (!keys.empty())
 			{
-				SendTransformData(dag.child(i), pComlib);
+				const float* prev = keys.back().rotation;
+				if (prev[0] * rotation.x + prev[1] * rotation.y + prev[2] * rotation.z + prev[3] * rotation.w < 0.0)
+					rotation.negateIt();
 			}
-		}
 
-		return true;
+			for (int k = 0; k < 3; k++)
+			{
+				key.scale[k] = (float)scale[k];
+				key.translation[k] = (float)translation[k];
+			}
+
+			key.rotation[0] = (float)rotation.x;
+			key.rotation[1] = (float)rotation.y;
+			key.rotation[2] = (float)rotation.z;
+			key.rotation[3] = (float)rotation.w;
+
+			keys.push_back(key);
+		}
 	}
 
-	return false;
+	AnimationClipHeader clipHeader{ (unsigned int)keys.size() };
+
+	const size_t size = sizeof(AnimationClipHeader) + sizeof(TransformKey) * keys.size();
+	char* pMessage = (char*)malloc(size);
+	if (!pMessage)
+		return false;
+
+	memcpy(pMessage, &clipHeader, sizeof(AnimationClipHeader));
+	if (!keys.empty())
+		memcpy(pMessage + sizeof(AnimationClipHeader), keys.data(), sizeof(TransformKey) * keys.size());
+
+	SectionHeader secHeader;
+	secHeader.name = name;
+	secHeader.header = ANIMATION_CLIP;
+	secHeader.messageLength = size;
+	sendMessage(pComlib, pMessage, &secHeader);
+
+	free(pMessage);
+
+	return true;
 }
 
-inline bool sendCamera(M3dView view, Comlib* pComlib)
+inline bool sendTimeSync(Comlib* pComlib)
 {
+	PROFILE_FUNCTION();
+
+	TimeSyncHeader sync{};
+	sync.time = getClipTime(MAnimControl::currentTime());
+	sync.playing = MAnimControl::isPlaying();
+
+	if (sync.time < 0.f)
+		sync.time = 0.f;
+
+	SectionHeader secHeader;
+	secHeader.header = TIME_SYNC;
+	secHeader.messageLength = sizeof(TimeSyncHeader);
+
+	return sendMessage(pComlib, (char*)&sync, &secHeader);
+}
+
+// Last camera state sent for a panel, see sendCamera. Belongs to the export worker
+struct SentCamera
+{
+	std::string name;
+	CameraHeader data;
+};
+
+inline bool sendCamera(M3dView view, Comlib* pComlib, SentCamera* pLastSent = nullptr)
+{
+	PROFILE_FUNCTION();
+
 	MStatus status;
 
 	view.updateViewingParameters();
@@ -273,7 +1000,9 @@ inline bool sendCamera(M3dView view, Comlib* pComlib)
 	if (M_FAIL(status))
 		return false;
 
-	CameraHeader cameraData{};
+	// Zeroed so padding doesn't break the comparison against pLastSent
+	CameraHeader cameraData;
+	memset(&cameraData, 0, sizeof(CameraHeader));
 
 	transform.transformationMatrix().get(cameraData.viewMatrix);
 	cameraData.fieldOfView = (float)camera.horizontalFieldOfView() * (180.f / (float)M_PI);
@@ -295,149 +1024,108 @@ inline bool sendCamera(M3dView view, Comlib* pComlib)
 	secHeader.messageLength = sizeof(CameraHeader);
 	secHeader.header = Headers::CAMERA_DATA;
 
-	pComlib->Send((char*)&cameraData, &secHeader);
-
-	return true;
-}
-
-inline bool sendColorValues(const MFnLambertShader& shader, const char* materialName, Comlib* pComlib)
-{
-	MStatus status;
-
-	const char* nodeName = shader.name(&status).asChar();
-	if (status == MS::kSuccess)
+	// Compared & updated on the export worker, after the sends queued before it. A failed send leaves the cache as it was,
+	// so the next call sends again even if nothing moved
+	const std::string name = transform.name().asChar();
+	runOnExportWorker([pComlib, pLastSent, name, cameraData, secHeader]() mutable
 	{
-		MaterialDataHeader matHeader{};
-		matHeader.color[0] = shader.color().r;
-		matHeader.color[1] = shader.color().g;
-		matHeader.color[2] = shader.color().b;
-		matHeader.color[3] = shader.color().a;
-
-		size_t matMsgLen = sizeof(MaterialDataHeader) + 1;
-		char* msg = new char[matMsgLen];
-		size_t offset = 0;
-
-		memcpy(msg + offset, &matHeader, sizeof(MaterialDataHeader));
-
-		SectionHeader secHeader;
-		secHeader.name = materialName;
-		secHeader.header = MATERIAL_DATA;
-		secHeader.messageLength = matMsgLen;
-		secHeader.messageID = 0;
-		pComlib->Send(msg, &secHeader);
-
-		delete[]msg;
+		// Nothing moved since the last send
+		if (pLastSent && pLastSent->name == name && memcmp(&pLastSent->data, &cameraData, sizeof(CameraHeader)) == 0)
+			return;
 
-		return true;
-	}
+		if (sendMessage(pComlib, (char*)&cameraData, &secHeader) && pLastSent)
+		{
+			pLastSent->name = name;
+			pLastSent->data = cameraData;
+		}
+	}, sizeof(CameraHeader));
 
-	return false;
+	return true;
 }
 
-inline bool sendColorTexture(const char* texturePath, const char* materialName, Comlib* pComlib)
+// Last material state sent for a shader, see SendMaterialData. Belongs to the export worker
+struct SentMaterial
 {
-	TextureDataHeader colorTexture{ texturePath };
-
-	SectionHeader secHeader;
-	secHeader.header = COLOR_TEXTURE;
-	secHeader.messageLength = sizeof(SectionHeader);
-	secHeader.name = materialName;
+	bool sent = false;
+	float color[4]{};
+	std::string diffuse;
+	std::string normal;
+};
+
+// Path of the file texture driving a plug, empty if there is none
+inline std::string getFileTexture(const MPlug& plug)
+{
+	MPlugArray connections;
+	plug.connectedTo(connections, true, false);
+	if (connections.length() == 0 || !connections[0].node().hasFn(MFn::kFileTexture))
+		return "";
 
-	pComlib->Send((char*)&colorTexture, &secHeader);
+	MString filename;
+	MFnDependencyNode(connections[0].node()).findPlug("ftn", false).getValue(filename);
 
-	return true;
+	return filename.asChar();
 }
 
-inline bool sendNormalTexture(const char* texturePath, const char* materialName, Comlib* pComlib)
+inline bool SendMaterialData(const MFnDependencyNode& material, Comlib* pComlib, SentMaterial* pLastSent = nullptr)
 {
-	TextureDataHeader colorTexture{ texturePath };
-
-	SectionHeader secHeader;
-	secHeader.header = NORMAL_TEXTURE;
-	secHeader.messageLength = sizeof(SectionHeader);
-	secHeader.name = materialName;
+	PROFILE_FUNCTION();
 
-	pComlib->Send((char*)&colorTexture, &secHeader);
+	MStatus status;
 
-	return true;
-}
+	if (!material.object().hasFn(MFn::kLambert))
+		return false;
 
-inline bool SendMaterialData(const MFnDependencyNode& material, Comlib* pComlib)
-{
-	MStatus status;
+	MFnLambertShader lambert(material.object(), &status);
+	if (M_FAIL(status))
+		return false;
 
-	MObject node = material.object();
+	SentMaterial current;
+	current.sent = true;
 
-	if (material.object().hasFn(MFn::kLambert))
-	{
-		MFnLambertShader tempLamb(node, &status);
-		if (M_FAIL(status))
-			return false;
+	const MColor color = lambert.color();
+	current.color[0] = color.r;
+	current.color[1] = color.g;
+	current.color[2] = color.b;
+	current.color[3] = color.a;
 
-		const char* matName = tempLamb.name().asChar();
+	current.diffuse = getFileTexture(lambert.findPlug("color", false));
 
-		MPlugArray lambertCon;
-		MPlug lambertPlug = tempLamb.findPlug("color", false);
-		lambertPlug.connectedTo(lambertCon, true, false);
-		bool hasTexture = false;
+	// Normal maps go through a bump node
+	MPlugArray connections;
+	lambert.findPlug("normalCamera", false).connectedTo(connections, true, false);
+	if (connections.length() > 0 && connections[0].node().hasFn(MFn::kBump))
+		current.normal = getFileTexture(MFnDependencyNode(connections[0].node()).findPlug("bumpValue", false));
 
-		if (lambertCon.length() > 0)
-		{
-			MObject obj(lambertCon[0].node());
-			if (obj.hasFn(MFn::kFileTexture))
-			{
-				MFnDependencyNode texture(obj);
-				MPlug file = texture.findPlug("ftn", false);
-				MString filename;
-				file.getValue(filename);
+	SectionHeader secHeader;
+	secHeader.name = lambert.name().asChar();
+	secHeader.header = MATERIAL_DELTA;
+	secHeader.messageLength = sizeof(MaterialDeltaHeader);
 
-				sendColorTexture(filename.asChar(), matName, pComlib);
-				hasTexture = true;
-			}
-		}
+	// The delta is taken against what Gameplay3D has received, on the export worker after the sends queued before it.
+	// A failed send leaves pLastSent as it was, the next edit sends the lost fields again
+	runOnExportWorker([pComlib, pLastSent, current, secHeader]() mutable
+	{
+		// Without a previous state everything is sent
+		const SentMaterial last = pLastSent ? *pLastSent : SentMaterial();
 
-		MPlug normPlug = tempLamb.findPlug("normalCamera", false);
-		normPlug.connectedTo(lambertCon, true, false);
+		MaterialDeltaHeader delta{};
+		if (!last.sent || memcmp(last.color, current.color, sizeof(current.color)) != 0)
+			delta.changed |= MATERIAL_COLOR;
+		if (!last.sent || last.diffuse != current.diffuse)
+			delta.changed |= MATERIAL_DIFFUSE;
+		if (!last.sent || last.normal != current.normal)
+			delta.changed |= MATERIAL_NORMAL;
 
-		bool normal = false;
-		if (lambertCon.length() > 0)
-		{
-			if (lambertCon[0].node().hasFn(MFn::kBump))
-			{
-				MFnDependencyNode bump(lambertCon[0].node());
-
-				MPlug bumpPlug = bump.findPlug("bumpValue", false);
-				bumpPlug.connectedTo(lambertCon, true, false);
-
-				if (lambertCon.length() > 0)
-				{
-					MObject obj(lambertCon[0].node());
-					if (obj.hasFn(MFn::kFileTexture))
-					{
-						MFnDependencyNode texture(obj);
-						MPlug file = texture.findPlug("ftn", false);
-						MString filename;
-						file.getValue(filename);
-
-						sendNormalTexture(filename.asChar(), matName, pComlib);
-						normal = true;
-					}
-				}
-			}
-		}
+		if (!delta.changed)
+			return;
 
-		if (!normal)
-			sendNormalTexture("", matName, pComlib);
+		memcpy(delta.color, current.color, sizeof(current.color));
+		delta.diffuse = current.diffuse;
+		delta.normal = current.normal;
 
-		if (!hasTexture)
-		{
-			tempLamb.hasAttribute("Color", &status);
-			if (M_OK(status))
-			{
-				sendColorValues(tempLamb, matName, pComlib);
-			}
-		}
-	}
+		if (sendMessage(pComlib, (char*)&delta, &secHeader) && pLastSent)
+			*pLastSent = current;
+	}, sizeof(MaterialDeltaHeader));
 
 	return true;
 }
@@ -487,6 +1175,8 @@ inline MObject getMaterial(const MObject& node)
 
 inline bool sendAttachedMaterial(const MObject& node, Comlib* pComlib)
 {
+	PROFILE_FUNCTION();
+
 	MStatus status;
 
 	MObject materialNode = getMaterial(node);
@@ -513,7 +1203,7 @@ inline bool sendAttachedMaterial(const MObject& node, Comlib* pComlib)
 	secHeader.messageLength = sizeof(MeshMaterialHeader);
 	secHeader.header = MESH_MATERIAL;
 
-	pComlib->Send((char*)&header, &secHeader);
+	sendMessage(pComlib, (char*)&header, &secHeader);
 
 	return true;
 }
\ No newline at end of file
@@ -0,0 +1,80 @@
+#pragma once
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <future>
+#include <functional>
+#include <queue>
+#include <vector>
+
+/*
+	Small fixed-size thread pool.
+	Jobs must not call the Maya API, only work on data gathered on the main thread.
+*/
+class WorkerPool
+{
+public:
+	WorkerPool(unsigned int numThreads = std::thread::hardware_concurrency())
+	{
+		if (numThreads == 0)
+			numThreads = 1;
+
+		for (unsigned int i = 0; i < numThreads; i++)
+			threads.emplace_back(&WorkerPool::run, this);
+	}
+
+	~WorkerPool()
+	{
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+		}
+		condition.notify_all();
+
+		for (std::thread& thread : threads)
+			thread.join();
+	}
+
+	std::future<void> push(std::function<void()> job)
+	{
+		std::packaged_task<void()> task(std::move(job));
+		std::future<void> future = task.get_future();
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push(std::move(task));
+		}
+		condition.notify_one();
+
+		return future;
+	}
+
+private:
+	void run()
+	{
+		while (true)
+		{
+			std::packaged_task<void()> task;
+
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				condition.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+				if (jobs.empty())
+					return;
+
+				task = std::move(jobs.front());
+				jobs.pop();
+			}
+
+			task();
+		}
+	}
+
+	std::vector<std::thread> threads;
+	std::queue<std::packaged_task<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable condition;
+	bool stopping = false;
+};
@@ -40,9 +40,26 @@
 #include <maya/MPlugArray.h>
 #include <maya/MSelectionList.h>
 #include <maya/MItDependencyNodes.h>
+#include <maya/MBoundingBox.h>
+#include <maya/MProgressWindow.h>
 #include <maya/MFnNumericAttribute.h>
 
 #include <maya/MDagPathArray.h>
+#include <maya/MObjectHandle.h>
+
+#include <maya/MTime.h>
+#include <maya/MAnimControl.h>
+#include <maya/MAnimUtil.h>
+#include <maya/MDGContext.h>
+#include <maya/MDGContextGuard.h>
+#include <maya/MFnMatrixData.h>
+#include <maya/MTransformationMatrix.h>
+#include <maya/MQuaternion.h>
+#include <maya/MItDependencyGraph.h>
+#include <maya/MFnSkinCluster.h>
+#include <maya/MFnSingleIndexedComponent.h>
+#include <maya/MFloatArray.h>
+#include <maya/MObjectArray.h>
 
 // Wrappers
 #include <maya/MGlobal.h>
@@ -59,9 +76,11 @@
 #include <maya/MDagMessage.h>
 #include <maya/MUiMessage.h>
 #include <maya/MModelMessage.h>
+#include <maya/MAnimMessage.h>
 
 // Commands
 #include <maya/MPxCommand.h>
+#include <maya/MArgList.h>
 
 #define M_OK(X) X == MS::kSuccess
 #define M_OK2 status == MS::kSuccess
@@ -65,6 +65,7 @@ SOURCES += src/AbsoluteLayout.cpp \
     src/MathUtil.cpp \
     src/MathUtil.inl \
     src/MathUtilNeon.inl \
+    src/MathUtilSSE.inl \
     src/Matrix.cpp \
     src/Matrix.inl \
     src/Mesh.cpp \
@@ -126,6 +127,7 @@ SOURCES += src/AbsoluteLayout.cpp \
     src/Texture.cpp \
     src/Theme.cpp \
     src/ThemeStyle.cpp \
+    src/ThreadPool.cpp \
     src/TileSet.cpp \
     src/Transform.cpp \
     src/Vector2.cpp \
@@ -376,6 +378,7 @@ HEADERS += src/AbsoluteLayout.h \
     src/Texture.h \
     src/Theme.h \
     src/ThemeStyle.h \
+    src/ThreadPool.h \
     src/TileSet.h \
     src/TimeListener.h \
     src/Touch.h \
@@ -14,7 +14,7 @@ extern void splitURL(const std::string& url, std::string* file, std::string* id)
 AnimationClip::AnimationClip(const char* id, Animation* animation, unsigned long startTime, unsigned long endTime)
     : _id(id), _animation(animation), _startTime(startTime), _endTime(endTime), _duration(_endTime - _startTime), 
       _stateBits(0x00), _repeatCount(1.0f), _loopBlendTime(0), _activeDuration(_duration * _repeatCount), _speed(1.0f), _timeStarted(0), 
-      _elapsedTime(0), _crossFadeToClip(NULL), _crossFadeOutElapsed(0), _crossFadeOutDuration(0), _blendWeight(1.0f),
+      _elapsedTime(0), _seekTime(-1.0f), _crossFadeToClip(NULL), _crossFadeOutElapsed(0), _crossFadeOutDuration(0), _blendWeight(1.0f),
       _beginListeners(NULL), _endListeners(NULL), _listeners(NULL), _listenerItr(NULL)
 {
     GP_REGISTER_SCRIPT_EVENTS();
@@ -98,6 +98,13 @@ float AnimationClip::getElapsedTime() const
     return _elapsedTime;
 }
 
+void AnimationClip::setElapsedTime(float elapsedTime)
+{
+    GP_ASSERT(elapsedTime >= 0.0f);
+
+    _seekTime = elapsedTime;
+}
+
 void AnimationClip::setRepeatCount(float repeatCount)
 {
     GP_ASSERT(repeatCount == REPEAT_INDEFINITE || repeatCount > 0.0f);
@@ -432,6 +439,13 @@ bool AnimationClip::update(float elapsedTime)
         }
     }
 
+    // A seek replaces the time advanced by this update
+    if (_seekTime >= 0.0f)
+    {
+        _elapsedTime = _seekTime;
+        _seekTime = -1.0f;
+    }
+
     // Current time within a loop of the clip
     float currentTime = 0.0f;
 
@@ -124,6 +124,15 @@ public:
      */
     float getElapsedTime() const;
 
+    /**
+     * Sets the AnimationClip's elapsed time, taking effect on the next update.
+     *
+     * Used to keep a playing clip in sync with an external clock.
+     *
+     * @param elapsedTime The elapsed time to seek to (in milliseconds).
+     */
+    void setElapsedTime(float elapsedTime);
+
     /**
      * Sets the AnimationClip's repeat count. Overrides repeat duration.
      *
@@ -398,6 +407,7 @@ private:
     float _speed;                                       // The speed that the clip is playing. Default is 1.0. Negative goes in reverse.
     double _timeStarted;                                // The game time when this clip was actually started.
     float _elapsedTime;                                 // Time elapsed while the clip is running.
+    float _seekTime;                                    // Elapsed time to apply on the next update, negative if none.
     AnimationClip* _crossFadeToClip;                    // The clip to cross fade to.
     float _crossFadeOutElapsed;                         // The amount of time that has elapsed for the crossfade.
     unsigned long _crossFadeOutDuration;                // The duration of the cross fade.
@@ -24,6 +24,15 @@ class Joint : public Node
 
 public:
 
+    /**
+     * Creates a new joint with the given id.
+     * 
+     * @param id ID string.
+     * 
+     * @return Newly created joint.
+     */
+    static Joint* create(const char* id);
+
     /**
      * @see Node::getType()
      */
@@ -49,6 +58,13 @@ public:
      */
     const Matrix& getInverseBindPose() const;
 
+    /**
+     * Sets the inverse bind pose matrix.
+     * 
+     * @param m Matrix representing the inverse bind pose for this Joint.
+     */
+    void setInverseBindPose(const Matrix& m);
+
 protected:
 
     /**
@@ -61,15 +77,6 @@ protected:
      */
     virtual ~Joint();
 
-    /**
-     * Creates a new joint with the given id.
-     * 
-     * @param id ID string.
-     * 
-     * @return Newly created joint.
-     */
-    static Joint* create(const char* id);
-
     /**
      * Clones a single node and its data but not its children.
      * This method returns a node pointer but actually creates a Joint.
@@ -80,13 +87,6 @@ protected:
      */
     virtual Node* cloneSingleNode(NodeCloneContext &context) const;
 
-    /**
-     * Sets the inverse bind pose matrix.
-     * 
-     * @param m Matrix representing the inverse bind pose for this Joint.
-     */
-    void setInverseBindPose(const Matrix& m);
-
     /**
      * Updates the joint matrix.
      * 
@@ -66,6 +66,11 @@ private:
 
     inline static void crossVector3(const float* v1, const float* v2, float* dst);
 
+    inline static void transformVector3Array(const float* m, float w, const float* v, size_t stride, unsigned int count, float* dst, size_t dstStride);
+
+    inline static void transformVector3ArraySoA(const float* m, float w, const float* x, const float* y, const float* z, unsigned int count,
+                                                float* dstX, float* dstY, float* dstZ);
+
     MathUtil();
 };
 
@@ -73,8 +78,18 @@ private:
 
 #define MATRIX_SIZE ( sizeof(float) * 16)
 
-#ifdef GP_USE_NEON
+// x86 builds use SSE unless GP_NO_SSE is defined, and 256-bit AVX where the compiler targets it (/arch:AVX2, -mavx2)
+#if !defined(GP_USE_NEON) && !defined(GP_NO_SSE) && (defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2) || defined(__SSE2__))
+#define GP_USE_SSE
+#if defined(__AVX2__) || defined(__AVX__)
+#define GP_USE_AVX
+#endif
+#endif
+
+#if defined(GP_USE_NEON)
 #include "MathUtilNeon.inl"
+#elif defined(GP_USE_SSE)
+#include "MathUtilSSE.inl"
 #else
 #include "MathUtil.inl"
 #endif
@@ -172,6 +172,30 @@ inline void MathUtil::crossVector3(const float* v1, const float* v2, float* dst)
     dst[2] = z;
 }
 
+inline void MathUtil::transformVector3Array(const float* m, float w, const float* v, size_t stride, unsigned int count, float* dst, size_t dstStride)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        const float* src = (const float*)((const char*)v + i * stride);
+        transformVector4(m, src[0], src[1], src[2], w, (float*)((char*)dst + i * dstStride));
+    }
 }
 
+inline void MathUtil::transformVector3ArraySoA(const float* m, float w, const float* x, const float* y, const float* z, unsigned int count,
+                                               float* dstX, float* dstY, float* dstZ)
+{
+    for (unsigned int i = 0; i < count; i++)
+    {
+        // Handle case where the source and destination arrays are the same.
+        float vx = x[i];
+        float vy = y[i];
+        float vz = z[i];
+
+        dstX[i] = vx * m[0] + vy * m[4] + vz * m[8] + w * m[12];
+        dstY[i] = vx * m[1] + vy * m[5] + vz * m[9] + w * m[13];
+        dstZ[i] = vx * m[2] + vy * m[6] + vz * m[10] + w * m[14];
+    }
+}
+
+}
 
@@ -0,0 +1,287 @@
+#include <xmmintrin.h>
+#ifdef GP_USE_AVX
+#include <immintrin.h>
+#endif
+
+// Every operation adds & multiplies in the same order as MathUtil.inl and never fuses them,
+// results are bit-exact with the scalar implementation.
+
+namespace gameplay
+{
+
+inline void MathUtil::addMatrix(const float* m, float scalar, float* dst)
+{
+    __m128 s = _mm_set1_ps(scalar);
+
+    __m128 col0 = _mm_add_ps(_mm_loadu_ps(&m[0]), s);  // DST->M[m0-m3] = M[m0-m3] + s
+    __m128 col1 = _mm_add_ps(_mm_loadu_ps(&m[4]), s);  // DST->M[m4-m7] = M[m4-m7] + s
+    __m128 col2 = _mm_add_ps(_mm_loadu_ps(&m[8]), s);  // DST->M[m8-m11] = M[m8-m11] + s
+    __m128 col3 = _mm_add_ps(_mm_loadu_ps(&m[12]), s); // DST->M[m12-m15] = M[m12-m15] + s
+
+    _mm_storeu_ps(&dst[0], col0);
+    _mm_storeu_ps(&dst[4], col1);
+    _mm_storeu_ps(&dst[8], col2);
+    _mm_storeu_ps(&dst[12], col3);
+}
+
+inline void MathUtil::addMatrix(const float* m1, const float* m2, float* dst)
+{
+    __m128 col0 = _mm_add_ps(_mm_loadu_ps(&m1[0]), _mm_loadu_ps(&m2[0]));   // DST->M[m0-m3] = M1[m0-m3] + M2[m0-m3]
+    __m128 col1 = _mm_add_ps(_mm_loadu_ps(&m1[4]), _mm_loadu_ps(&m2[4]));   // DST->M[m4-m7] = M1[m4-m7] + M2[m4-m7]
+    __m128 col2 = _mm_add_ps(_mm_loadu_ps(&m1[8]), _mm_loadu_ps(&m2[8]));   // DST->M[m8-m11] = M1[m8-m11] + M2[m8-m11]
+    __m128 col3 = _mm_add_ps(_mm_loadu_ps(&m1[12]), _mm_loadu_ps(&m2[12])); // DST->M[m12-m15] = M1[m12-m15] + M2[m12-m15]
+
+    _mm_storeu_ps(&dst[0], col0);
+    _mm_storeu_ps(&dst[4], col1);
+    _mm_storeu_ps(&dst[8], col2);
+    _mm_storeu_ps(&dst[12], col3);
+}
+
+inline void MathUtil::subtractMatrix(const float* m1, const float* m2, float* dst)
+{
+    __m128 col0 = _mm_sub_ps(_mm_loadu_ps(&m1[0]), _mm_loadu_ps(&m2[0]));   // DST->M[m0-m3] = M1[m0-m3] - M2[m0-m3]
+    __m128 col1 = _mm_sub_ps(_mm_loadu_ps(&m1[4]), _mm_loadu_ps(&m2[4]));   // DST->M[m4-m7] = M1[m4-m7] - M2[m4-m7]
+    __m128 col2 = _mm_sub_ps(_mm_loadu_ps(&m1[8]), _mm_loadu_ps(&m2[8]));   // DST->M[m8-m11] = M1[m8-m11] - M2[m8-m11]
+    __m128 col3 = _mm_sub_ps(_mm_loadu_ps(&m1[12]), _mm_loadu_ps(&m2[12])); // DST->M[m12-m15] = M1[m12-m15] - M2[m12-m15]
+
+    _mm_storeu_ps(&dst[0], col0);
+    _mm_storeu_ps(&dst[4], col1);
+    _mm_storeu_ps(&dst[8], col2);
+    _mm_storeu_ps(&dst[12], col3);
+}
+
+inline void MathUtil::multiplyMatrix(const float* m, float scalar, float* dst)
+{
+    __m128 s = _mm_set1_ps(scalar);
+
+    __m128 col0 = _mm_mul_ps(_mm_loadu_ps(&m[0]), s);  // DST->M[m0-m3] = M[m0-m3] * s
+    __m128 col1 = _mm_mul_ps(_mm_loadu_ps(&m[4]), s);  // DST->M[m4-m7] = M[m4-m7] * s
+    __m128 col2 = _mm_mul_ps(_mm_loadu_ps(&m[8]), s);  // DST->M[m8-m11] = M[m8-m11] * s
+    __m128 col3 = _mm_mul_ps(_mm_loadu_ps(&m[12]), s); // DST->M[m12-m15] = M[m12-m15] * s
+
+    _mm_storeu_ps(&dst[0], col0);
+    _mm_storeu_ps(&dst[4], col1);
+    _mm_storeu_ps(&dst[8], col2);
+    _mm_storeu_ps(&dst[12], col3);
+}
+
+#ifdef GP_USE_AVX
+
+inline void MathUtil::multiplyMatrix(const float* m1, const float* m2, float* dst)
+{
+    // M1's columns in both halves, two of DST's columns are computed at once.
+    // All loads happen before the stores, m1 or m2 may be the same array as dst.
+    __m256 a0 = _mm256_broadcast_ps((const __m128*)&m1[0]);    // M1[m0-m3] | M1[m0-m3]
+    __m256 a1 = _mm256_broadcast_ps((const __m128*)&m1[4]);    // M1[m4-m7] | M1[m4-m7]
+    __m256 a2 = _mm256_broadcast_ps((const __m128*)&m1[8]);    // M1[m8-m11] | M1[m8-m11]
+    __m256 a3 = _mm256_broadcast_ps((const __m128*)&m1[12]);   // M1[m12-m15] | M1[m12-m15]
+
+    __m256 b01 = _mm256_loadu_ps(&m2[0]);                       // M2[m0-m3] | M2[m4-m7]
+    __m256 b23 = _mm256_loadu_ps(&m2[8]);                       // M2[m8-m11] | M2[m12-m15]
+
+    // DST->M[m0-m7] = M1 * M2[m0-m7]
+    __m256 c01 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(0, 0, 0, 0)));
+    c01 = _mm256_add_ps(c01, _mm256_mul_ps(a1, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(1, 1, 1, 1))));
+    c01 = _mm256_add_ps(c01, _mm256_mul_ps(a2, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(2, 2, 2, 2))));
+    c01 = _mm256_add_ps(c01, _mm256_mul_ps(a3, _mm256_shuffle_ps(b01, b01, _MM_SHUFFLE(3, 3, 3, 3))));
+
+    // DST->M[m8-m15] = M1 * M2[m8-m15]
+    __m256 c23 = _mm256_mul_ps(a0, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(0, 0, 0, 0)));
+    c23 = _mm256_add_ps(c23, _mm256_mul_ps(a1, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(1, 1, 1, 1))));
+    c23 = _mm256_add_ps(c23, _mm256_mul_ps(a2, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(2, 2, 2, 2))));
+    c23 = _mm256_add_ps(c23, _mm256_mul_ps(a3, _mm256_shuffle_ps(b23, b23, _MM_SHUFFLE(3, 3, 3, 3))));
+
+    _mm256_storeu_ps(&dst[0], c01);
+    _mm256_storeu_ps(&dst[8], c23);
+}
+
+#else
+
+inline void MathUtil::multiplyMatrix(const float* m1, const float* m2, float* dst)
+{
+    // All loads happen before the stores, m1 or m2 may be the same array as dst.
+    __m128 a0 = _mm_loadu_ps(&m1[0]);   // M1[m0-m3]
+    __m128 a1 = _mm_loadu_ps(&m1[4]);   // M1[m4-m7]
+    __m128 a2 = _mm_loadu_ps(&m1[8]);   // M1[m8-m11]
+    __m128 a3 = _mm_loadu_ps(&m1[12]);  // M1[m12-m15]
+
+    __m128 b0 = _mm_loadu_ps(&m2[0]);   // M2[m0-m3]
+    __m128 b1 = _mm_loadu_ps(&m2[4]);   // M2[m4-m7]
+    __m128 b2 = _mm_loadu_ps(&m2[8]);   // M2[m8-m11]
+    __m128 b3 = _mm_loadu_ps(&m2[12]);  // M2[m12-m15]
+
+    __m128 c[4];
+    const __m128 b[4] = { b0, b1, b2, b3 };
+    for (int i = 0; i < 4; i++)
+    {
+        // DST->M[m4i-m4i+3] = M1 * M2[m4i-m4i+3]
+        __m128 column = _mm_mul_ps(a0, _mm_shuffle_ps(b[i], b[i], _MM_SHUFFLE(0, 0, 0, 0)));
+        column = _mm_add_ps(column, _mm_mul_ps(a1, _mm_shuffle_ps(b[i], b[i], _MM_SHUFFLE(1, 1, 1, 1))));
+        column = _mm_add_ps(column, _mm_mul_ps(a2, _mm_shuffle_ps(b[i], b[i], _MM_SHUFFLE(2, 2, 2, 2))));
+        column = _mm_add_ps(column, _mm_mul_ps(a3, _mm_shuffle_ps(b[i], b[i], _MM_SHUFFLE(3, 3, 3, 3))));
+        c[i] = column;
+    }
+
+    _mm_storeu_ps(&dst[0], c[0]);
+    _mm_storeu_ps(&dst[4], c[1]);
+    _mm_storeu_ps(&dst[8], c[2]);
+    _mm_storeu_ps(&dst[12], c[3]);
+}
+
+#endif
+
+inline void MathUtil::negateMatrix(const float* m, float* dst)
+{
+    // Flips the sign bit, like the scalar unary minus (0 becomes -0)
+    __m128 sign = _mm_set1_ps(-0.0f);
+
+    __m128 col0 = _mm_xor_ps(_mm_loadu_ps(&m[0]), sign);   // DST->M[m0-m3] = -M[m0-m3]
+    __m128 col1 = _mm_xor_ps(_mm_loadu_ps(&m[4]), sign);   // DST->M[m4-m7] = -M[m4-m7]
+    __m128 col2 = _mm_xor_ps(_mm_loadu_ps(&m[8]), sign);   // DST->M[m8-m11] = -M[m8-m11]
+    __m128 col3 = _mm_xor_ps(_mm_loadu_ps(&m[12]), sign);  // DST->M[m12-m15] = -M[m12-m15]
+
+    _mm_storeu_ps(&dst[0], col0);
+    _mm_storeu_ps(&dst[4], col1);
+    _mm_storeu_ps(&dst[8], col2);
+    _mm_storeu_ps(&dst[12], col3);
+}
+
+inline void MathUtil::transposeMatrix(const float* m, float* dst)
+{
+    __m128 col0 = _mm_loadu_ps(&m[0]);      // M[m0-m3]
+    __m128 col1 = _mm_loadu_ps(&m[4]);      // M[m4-m7]
+    __m128 col2 = _mm_loadu_ps(&m[8]);      // M[m8-m11]
+    __m128 col3 = _mm_loadu_ps(&m[12]);     // M[m12-m15]
+
+    _MM_TRANSPOSE4_PS(col0, col1, col2, col3);
+
+    _mm_storeu_ps(&dst[0], col0);           // DST->M[m0-m3] = M[m0, m4, m8, m12]
+    _mm_storeu_ps(&dst[4], col1);           // DST->M[m4-m7] = M[m1, m5, m9, m13]
+    _mm_storeu_ps(&dst[8], col2);           // DST->M[m8-m11] = M[m2, m6, m10, m14]
+    _mm_storeu_ps(&dst[12], col3);          // DST->M[m12-m15] = M[m3, m7, m11, m15]
+}
+
+inline void MathUtil::transformVector4(const float* m, float x, float y, float z, float w, float* dst)
+{
+    __m128 v = _mm_mul_ps(_mm_loadu_ps(&m[0]), _mm_set1_ps(x));           // DST = M[m0-m3] * x
+    v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(&m[4]), _mm_set1_ps(y)));   // DST += M[m4-m7] * y
+    v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(&m[8]), _mm_set1_ps(z)));   // DST += M[m8-m11] * z
+    v = _mm_add_ps(v, _mm_mul_ps(_mm_loadu_ps(&m[12]), _mm_set1_ps(w)));  // DST += M[m12-m15] * w
+
+    // dst only holds x, y & z
+    _mm_storel_pi((__m64*)dst, v);
+    _mm_store_ss(&dst[2], _mm_movehl_ps(v, v));
+}
+
+inline void MathUtil::transformVector4(const float* m, const float* v, float* dst)
+{
+    // Loaded before the store, v may be the same array as dst.
+    __m128 vector = _mm_loadu_ps(v);
+
+    __m128 result = _mm_mul_ps(_mm_loadu_ps(&m[0]), _mm_shuffle_ps(vector, vector, _MM_SHUFFLE(0, 0, 0, 0)));            // DST = M[m0-m3] * V[0]
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(&m[4]), _mm_shuffle_ps(vector, vector, _MM_SHUFFLE(1, 1, 1, 1))));  // DST += M[m4-m7] * V[1]
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(&m[8]), _mm_shuffle_ps(vector, vector, _MM_SHUFFLE(2, 2, 2, 2))));  // DST += M[m8-m11] * V[2]
+    result = _mm_add_ps(result, _mm_mul_ps(_mm_loadu_ps(&m[12]), _mm_shuffle_ps(vector, vector, _MM_SHUFFLE(3, 3, 3, 3)))); // DST += M[m12-m15] * V[3]
+
+    _mm_storeu_ps(dst, result);
+}
+
+inline void MathUtil::crossVector3(const float* v1, const float* v2, float* dst)
+{
+    // Vector3 is only 3 floats, a 4 wide load would read past it. Shuffling them in costs more than the scalar math
+    float x = (v1[1] * v2[2]) - (v1[2] * v2[1]);
+    float y = (v1[2] * v2[0]) - (v1[0] * v2[2]);
+    float z = (v1[0] * v2[1]) - (v1[1] * v2[0]);
+
+    dst[0] = x;
+    dst[1] = y;
+    dst[2] = z;
+}
+
+inline void MathUtil::transformVector3Array(const float* m, float w, const float* v, size_t stride, unsigned int count, float* dst, size_t dstStride)
+{
+    // The matrix stays in registers for the whole array
+    __m128 col0 = _mm_loadu_ps(&m[0]);                                  // M[m0-m3]
+    __m128 col1 = _mm_loadu_ps(&m[4]);                                  // M[m4-m7]
+    __m128 col2 = _mm_loadu_ps(&m[8]);                                  // M[m8-m11]
+    __m128 col3 = _mm_mul_ps(_mm_loadu_ps(&m[12]), _mm_set1_ps(w));     // M[m12-m15] * w
+
+    for (unsigned int i = 0; i < count; i++)
+    {
+        // 3 floats each, loaded one by one so the last one never reads past the array
+        const float* src = (const float*)((const char*)v + i * stride);
+        float* out = (float*)((char*)dst + i * dstStride);
+
+        __m128 result = _mm_mul_ps(col0, _mm_set1_ps(src[0]));          // DST = M[m0-m3] * V[x]
+        result = _mm_add_ps(result, _mm_mul_ps(col1, _mm_set1_ps(src[1])));  // DST += M[m4-m7] * V[y]
+        result = _mm_add_ps(result, _mm_mul_ps(col2, _mm_set1_ps(src[2])));  // DST += M[m8-m11] * V[z]
+        result = _mm_add_ps(result, col3);                              // DST += M[m12-m15] * w
+
+        _mm_storel_pi((__m64*)out, result);
+        _mm_store_ss(&out[2], _mm_movehl_ps(result, result));
+    }
+}
+
+inline void MathUtil::transformVector3ArraySoA(const float* m, float w, const float* x, const float* y, const float* z, unsigned int count,
+                                               float* dstX, float* dstY, float* dstZ)
+{
+    unsigned int i = 0;
+
+    // Every lane is its own vector, the matrix elements are broadcast
+#ifdef GP_USE_AVX
+    {
+        const __m256 m0 = _mm256_set1_ps(m[0]), m1 = _mm256_set1_ps(m[1]), m2 = _mm256_set1_ps(m[2]);
+        const __m256 m4 = _mm256_set1_ps(m[4]), m5 = _mm256_set1_ps(m[5]), m6 = _mm256_set1_ps(m[6]);
+        const __m256 m8 = _mm256_set1_ps(m[8]), m9 = _mm256_set1_ps(m[9]), m10 = _mm256_set1_ps(m[10]);
+        const __m256 wx = _mm256_set1_ps(w * m[12]), wy = _mm256_set1_ps(w * m[13]), wz = _mm256_set1_ps(w * m[14]);
+
+        for (; i + 8 <= count; i += 8)
+        {
+            __m256 vx = _mm256_loadu_ps(&x[i]);
+            __m256 vy = _mm256_loadu_ps(&y[i]);
+            __m256 vz = _mm256_loadu_ps(&z[i]);
+
+            __m256 rx = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, m0), _mm256_mul_ps(vy, m4)), _mm256_mul_ps(vz, m8)), wx);
+            __m256 ry = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, m1), _mm256_mul_ps(vy, m5)), _mm256_mul_ps(vz, m9)), wy);
+            __m256 rz = _mm256_add_ps(_mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(vx, m2), _mm256_mul_ps(vy, m6)), _mm256_mul_ps(vz, m10)), wz);
+
+            _mm256_storeu_ps(&dstX[i], rx);
+            _mm256_storeu_ps(&dstY[i], ry);
+            _mm256_storeu_ps(&dstZ[i], rz);
+        }
+    }
+#endif
+
+    const __m128 m0 = _mm_set1_ps(m[0]), m1 = _mm_set1_ps(m[1]), m2 = _mm_set1_ps(m[2]);
+    const __m128 m4 = _mm_set1_ps(m[4]), m5 = _mm_set1_ps(m[5]), m6 = _mm_set1_ps(m[6]);
+    const __m128 m8 = _mm_set1_ps(m[8]), m9 = _mm_set1_ps(m[9]), m10 = _mm_set1_ps(m[10]);
+    const __m128 wx = _mm_set1_ps(w * m[12]), wy = _mm_set1_ps(w * m[13]), wz = _mm_set1_ps(w * m[14]);
+
+    for (; i + 4 <= count; i += 4)
+    {
+        __m128 vx = _mm_loadu_ps(&x[i]);
+        __m128 vy = _mm_loadu_ps(&y[i]);
+        __m128 vz = _mm_loadu_ps(&z[i]);
+
+        __m128 rx = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m0), _mm_mul_ps(vy, m4)), _mm_mul_ps(vz, m8)), wx);
+        __m128 ry = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m1), _mm_mul_ps(vy, m5)), _mm_mul_ps(vz, m9)), wy);
+        __m128 rz = _mm_add_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(vx, m2), _mm_mul_ps(vy, m6)), _mm_mul_ps(vz, m10)), wz);
+
+        _mm_storeu_ps(&dstX[i], rx);
+        _mm_storeu_ps(&dstY[i], ry);
+        _mm_storeu_ps(&dstZ[i], rz);
+    }
+
+    for (; i < count; i++)
+    {
+        float vx = x[i];
+        float vy = y[i];
+        float vz = z[i];
+
+        dstX[i] = vx * m[0] + vy * m[4] + vz * m[8] + w * m[12];
+        dstY[i] = vx * m[1] + vy * m[5] + vz * m[9] + w * m[13];
+        dstZ[i] = vx * m[2] + vy * m[6] + vz * m[10] + w * m[14];
+    }
+}
+
+}
@@ -3,6 +3,7 @@
 #include "Plane.h"
 #include "Quaternion.h"
 #include "MathUtil.h"
+#include "ThreadPool.h"
 
 namespace gameplay
 {
@@ -15,6 +16,9 @@ static const float MATRIX_IDENTITY[16] =
     0.0f, 0.0f, 0.0f, 1.0f
 };
 
+// Fewer points than this per thread isn't worth handing to the ThreadPool.
+static const unsigned int MIN_POINTS_PER_THREAD = 16384;
+
 Matrix::Matrix()
 {
     *this = Matrix::identity();
@@ -934,6 +938,88 @@ void Matrix::transformVector(const Vector4& vector, Vector4* dst) const
     MathUtil::transformVector4(m, (const float*) &vector, (float*)dst);
 }
 
+void Matrix::transformPoints(const Vector3* points, unsigned int count, Vector3* dst) const
+{
+    transformArray(1.0f, (const float*)points, sizeof(Vector3), count, (float*)dst, sizeof(Vector3));
+}
+
+void Matrix::transformPoints(const float* points, size_t stride, unsigned int count, float* dst, size_t dstStride) const
+{
+    transformArray(1.0f, points, stride, count, dst, dstStride);
+}
+
+void Matrix::transformPoints(const float* x, const float* y, const float* z, unsigned int count, float* dstX, float* dstY, float* dstZ) const
+{
+    transformArraySoA(1.0f, x, y, z, count, dstX, dstY, dstZ);
+}
+
+void Matrix::transformVectors(const Vector3* vectors, unsigned int count, Vector3* dst) const
+{
+    transformArray(0.0f, (const float*)vectors, sizeof(Vector3), count, (float*)dst, sizeof(Vector3));
+}
+
+void Matrix::transformVectors(const float* vectors, size_t stride, unsigned int count, float* dst, size_t dstStride) const
+{
+    transformArray(0.0f, vectors, stride, count, dst, dstStride);
+}
+
+void Matrix::transformVectors(const float* x, const float* y, const float* z, unsigned int count, float* dstX, float* dstY, float* dstZ) const
+{
+    transformArraySoA(0.0f, x, y, z, count, dstX, dstY, dstZ);
+}
+
+void Matrix::transformNormals(const Vector3* normals, unsigned int count, Vector3* dst) const
+{
+    transformNormals((const float*)normals, sizeof(Vector3), count, (float*)dst, sizeof(Vector3));
+}
+
+void Matrix::transformNormals(const float* normals, size_t stride, unsigned int count, float* dst, size_t dstStride) const
+{
+    GP_ASSERT(count == 0 || (normals && dst));
+
+    // A singular matrix flattens the normals anyway, transforming by it as is keeps them defined.
+    Matrix normalMatrix;
+    if (!invert(&normalMatrix))
+    {
+        normalMatrix = *this;
+    }
+    normalMatrix.transpose();
+
+    ThreadPool::parallelFor(count, MIN_POINTS_PER_THREAD, [&](unsigned int begin, unsigned int end)
+    {
+        const float* src = (const float*)((const char*)normals + begin * stride);
+        float* out = (float*)((char*)dst + begin * dstStride);
+
+        MathUtil::transformVector3Array(normalMatrix.m, 0.0f, src, stride, end - begin, out, dstStride);
+
+        for (unsigned int i = begin; i < end; i++)
+        {
+            ((Vector3*)((char*)dst + i * dstStride))->normalize();
+        }
+    });
+}
+
+void Matrix::transformArray(float w, const float* src, size_t stride, unsigned int count, float* dst, size_t dstStride) const
+{
+    GP_ASSERT(count == 0 || (src && dst));
+
+    ThreadPool::parallelFor(count, MIN_POINTS_PER_THREAD, [&](unsigned int begin, unsigned int end)
+    {
+        MathUtil::transformVector3Array(m, w, (const float*)((const char*)src + begin * stride), stride, end - begin,
+                                        (float*)((char*)dst + begin * dstStride), dstStride);
+    });
+}
+
+void Matrix::transformArraySoA(float w, const float* x, const float* y, const float* z, unsigned int count, float* dstX, float* dstY, float* dstZ) const
+{
+    GP_ASSERT(count == 0 || (x && y && z && dstX && dstY && dstZ));
+
+    ThreadPool::parallelFor(count, MIN_POINTS_PER_THREAD, [&](unsigned int begin, unsigned int end)
+    {
+        MathUtil::transformVector3ArraySoA(m, w, x + begin, y + begin, z + begin, end - begin, dstX + begin, dstY + begin, dstZ + begin);
+    });
+}
+
 void Matrix::translate(float x, float y, float z)
 {
     translate(x, y, z, this);
@@ -810,6 +810,100 @@ public:
      */
     void transformVector(const Vector4& vector, Vector4* dst) const;
 
+    /**
+     * Transforms an array of points by this matrix, treating the fourth (w) coordinate as one.
+     *
+     * Arrays larger than a few ten thousand points are split over multiple threads.
+     *
+     * @param points The points to transform.
+     * @param count The number of points.
+     * @param dst The array to store the transformed points in, may be points.
+     */
+    void transformPoints(const Vector3* points, unsigned int count, Vector3* dst) const;
+
+    /**
+     * Transforms an array of points by this matrix, treating the fourth (w) coordinate as one.
+     *
+     * Each point is three consecutive floats, which lets the points be members of
+     * larger structures such as vertices or particles.
+     *
+     * @param points The x-coordinate of the first point.
+     * @param stride The number of bytes from one point to the next.
+     * @param count The number of points.
+     * @param dst The x-coordinate of the first transformed point, may be points if dstStride is stride.
+     * @param dstStride The number of bytes from one transformed point to the next.
+     */
+    void transformPoints(const float* points, size_t stride, unsigned int count, float* dst, size_t dstStride) const;
+
+    /**
+     * Transforms points stored as separate x, y and z arrays by this matrix,
+     * treating the fourth (w) coordinate as one.
+     *
+     * @param x The x-coordinates of the points.
+     * @param y The y-coordinates of the points.
+     * @param z The z-coordinates of the points.
+     * @param count The number of points.
+     * @param dstX The array to store the transformed x-coordinates in, may be x.
+     * @param dstY The array to store the transformed y-coordinates in, may be y.
+     * @param dstZ The array to store the transformed z-coordinates in, may be z.
+     */
+    void transformPoints(const float* x, const float* y, const float* z, unsigned int count, float* dstX, float* dstY, float* dstZ) const;
+
+    /**
+     * Transforms an array of vectors by this matrix, treating the fourth (w) coordinate as zero.
+     *
+     * @param vectors The vectors to transform.
+     * @param count The number of vectors.
+     * @param dst The array to store the transformed vectors in, may be vectors.
+     */
+    void transformVectors(const Vector3* vectors, unsigned int count, Vector3* dst) const;
+
+    /**
+     * Transforms an array of vectors by this matrix, treating the fourth (w) coordinate as zero.
+     *
+     * @param vectors The x-coordinate of the first vector.
+     * @param stride The number of bytes from one vector to the next.
+     * @param count The number of vectors.
+     * @param dst The x-coordinate of the first transformed vector, may be vectors if dstStride is stride.
+     * @param dstStride The number of bytes from one transformed vector to the next.
+     */
+    void transformVectors(const float* vectors, size_t stride, unsigned int count, float* dst, size_t dstStride) const;
+
+    /**
+     * Transforms vectors stored as separate x, y and z arrays by this matrix,
+     * treating the fourth (w) coordinate as zero.
+     *
+     * @param x The x-coordinates of the vectors.
+     * @param y The y-coordinates of the vectors.
+     * @param z The z-coordinates of the vectors.
+     * @param count The number of vectors.
+     * @param dstX The array to store the transformed x-coordinates in, may be x.
+     * @param dstY The array to store the transformed y-coordinates in, may be y.
+     * @param dstZ The array to store the transformed z-coordinates in, may be z.
+     */
+    void transformVectors(const float* x, const float* y, const float* z, unsigned int count, float* dstX, float* dstY, float* dstZ) const;
+
+    /**
+     * Transforms an array of normals by the inverse transpose of this matrix and normalizes them,
+     * so they stay perpendicular to their surface under non-uniform scale.
+     *
+     * @param normals The normals to transform.
+     * @param count The number of normals.
+     * @param dst The array to store the transformed normals in, may be normals.
+     */
+    void transformNormals(const Vector3* normals, unsigned int count, Vector3* dst) const;
+
+    /**
+     * Transforms an array of normals by the inverse transpose of this matrix and normalizes them.
+     *
+     * @param normals The x-coordinate of the first normal.
+     * @param stride The number of bytes from one normal to the next.
+     * @param count The number of normals.
+     * @param dst The x-coordinate of the first transformed normal, may be normals if dstStride is stride.
+     * @param dstStride The number of bytes from one transformed normal to the next.
+     */
+    void transformNormals(const float* normals, size_t stride, unsigned int count, float* dst, size_t dstStride) const;
+
     /**
      * Post-multiplies this matrix by the matrix corresponding to the
      * specified translation.
@@ -925,6 +1019,10 @@ public:
     
 private:
 
+    void transformArray(float w, const float* src, size_t stride, unsigned int count, float* dst, size_t dstStride) const;
+
+    void transformArraySoA(float w, const float* x, const float* y, const float* z, unsigned int count, float* dstX, float* dstY, float* dstZ) const;
+
     static void createBillboardHelper(const Vector3& objectPosition, const Vector3& cameraPosition,
                                       const Vector3& cameraUpVector, const Vector3* cameraForwardVector,
                                       Matrix* dst);
@@ -292,6 +292,24 @@ void Mesh::setVertexData(const void* vertexData, unsigned int vertexStart, unsig
     }
 }
 
+void Mesh::setVertexDataRanges(const void* vertexData, const unsigned int* ranges, unsigned int rangeCount)
+{
+    GP_ASSERT(vertexData);
+    GP_ASSERT(ranges || rangeCount == 0);
+
+    GL_ASSERT( glBindBuffer(GL_ARRAY_BUFFER, _vertexBuffer) );
+
+    const unsigned int vertexSize = _vertexFormat.getVertexSize();
+    for (unsigned int i = 0; i < rangeCount; ++i)
+    {
+        const unsigned int vertexStart = ranges[i * 2];
+        const unsigned int vertexCount = ranges[i * 2 + 1];
+        GP_ASSERT(vertexStart + vertexCount <= _vertexCount);
+
+        GL_ASSERT( glBufferSubData(GL_ARRAY_BUFFER, vertexStart * vertexSize, vertexCount * vertexSize, (const unsigned char*)vertexData + vertexStart * vertexSize) );
+    }
+}
+
 MeshPart* Mesh::addPart(PrimitiveType primitiveType, IndexFormat indexFormat, unsigned int indexCount, bool dynamic)
 {
     MeshPart* part = MeshPart::create(this, _partCount, primitiveType, indexFormat, indexCount, dynamic);
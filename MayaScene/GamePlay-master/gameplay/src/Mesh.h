@@ -241,6 +241,19 @@ public:
      */
     void setVertexData(const void* vertexData, unsigned int vertexStart = 0, unsigned int vertexCount = 0);
 
+    /**
+     * Sets several ranges of vertex data, leaving the vertices between them as they are.
+     *
+     * Only the vertices in the ranges are uploaded. To replace all vertices, setVertexData with
+     * the default range respecifies the whole buffer instead, which lets the driver orphan the old
+     * storage rather than wait for draws that are still reading it.
+     *
+     * @param vertexData The data of all vertices, each range is read from its own offset.
+     * @param ranges Pairs of starting vertex and vertex count.
+     * @param rangeCount The number of pairs in ranges.
+     */
+    void setVertexDataRanges(const void* vertexData, const unsigned int* ranges, unsigned int rangeCount);
+
     /**
      * Creates and adds a new part of primitive data defining how the vertices are connected.
      *
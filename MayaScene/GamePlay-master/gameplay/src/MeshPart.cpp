@@ -130,6 +130,40 @@ void MeshPart::setIndexData(const void* indexData, unsigned int indexStart, unsi
     }
 }
 
+void MeshPart::setIndexDataRanges(const void* indexData, const unsigned int* ranges, unsigned int rangeCount)
+{
+    GP_ASSERT(indexData);
+    GP_ASSERT(ranges || rangeCount == 0);
+
+    GL_ASSERT( glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, _indexBuffer) );
+
+    unsigned int indexSize = 0;
+    switch (_indexFormat)
+    {
+    case Mesh::INDEX8:
+        indexSize = 1;
+        break;
+    case Mesh::INDEX16:
+        indexSize = 2;
+        break;
+    case Mesh::INDEX32:
+        indexSize = 4;
+        break;
+    default:
+        GP_ERROR("Unsupported index format (%d).", _indexFormat);
+        return;
+    }
+
+    for (unsigned int i = 0; i < rangeCount; ++i)
+    {
+        const unsigned int indexStart = ranges[i * 2];
+        const unsigned int indexCount = ranges[i * 2 + 1];
+        GP_ASSERT(indexStart + indexCount <= _indexCount);
+
+        GL_ASSERT( glBufferSubData(GL_ELEMENT_ARRAY_BUFFER, indexStart * indexSize, indexCount * indexSize, (const unsigned char*)indexData + indexStart * indexSize) );
+    }
+}
+
 bool MeshPart::isDynamic() const
 {
     return _dynamic;
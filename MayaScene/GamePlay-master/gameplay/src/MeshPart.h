@@ -99,6 +99,20 @@ public:
      */
     void setIndexData(const void* indexData, unsigned int indexStart, unsigned int indexCount);
 
+    /**
+     * Sets several ranges of index data, leaving the indices between them as they are.
+     *
+     * Only the indices in the ranges are uploaded. To replace all indices, setIndexData with
+     * a start and count of 0 respecifies the whole buffer instead, which lets the driver orphan
+     * the old storage rather than wait for draws that are still reading it.
+     *
+     * @param indexData The data of all indices, each range is read from its own offset.
+     * @param ranges Pairs of starting index and index count.
+     * @param rangeCount The number of pairs in ranges.
+     * @script{ignore}
+     */
+    void setIndexDataRanges(const void* indexData, const unsigned int* ranges, unsigned int rangeCount);
+
     /**
      * Determines if the indices are dynamic.
      *
@@ -14,6 +14,13 @@ MeshSkin::MeshSkin()
 {
 }
 
+MeshSkin* MeshSkin::create(unsigned int jointCount)
+{
+    MeshSkin* skin = new MeshSkin();
+    skin->setJointCount(jointCount);
+    return skin;
+}
+
 MeshSkin::~MeshSkin()
 {
     clearJoints();
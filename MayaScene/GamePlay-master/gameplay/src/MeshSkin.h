@@ -30,6 +30,24 @@ class MeshSkin : public Transform::Listener
 
 public:
 
+    /**
+     * Creates an empty skin with room for the given number of joints.
+     * The skin is owned by the Model it is set on, see Model::setSkin.
+     *
+     * @param jointCount The number of joints in the skin.
+     *
+     * @return The new skin.
+     */
+    static MeshSkin* create(unsigned int jointCount);
+
+    /**
+     * Sets the joint at the given index.
+     *
+     * @param joint The joint, referenced by the skin.
+     * @param index The index of the joint in the matrix palette.
+     */
+    void setJoint(Joint* joint, unsigned int index);
+
     /**
      * Returns the bind shape matrix.
      * 
@@ -155,14 +173,6 @@ private:
      */
     void setJointCount(unsigned int jointCount);
 
-    /**
-     * Sets the joint at the given index and increments the ref count.
-     * 
-     * @param joint The joint to be set.
-     * @param index The index in the joints vector.
-     */
-    void setJoint(Joint* joint, unsigned int index);
-
     /**
      * Sets the root node of this mesh skin.
      * 
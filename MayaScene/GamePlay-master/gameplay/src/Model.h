@@ -130,6 +130,13 @@ public:
      */
     MeshSkin* getSkin() const;
 
+    /**
+     * Sets the MeshSkin for this model, the model takes ownership of it.
+     *
+     * @param skin The MeshSkin for this model.
+     */
+    void setSkin(MeshSkin* skin);
+
     /**
      * @see Drawable::draw
      *
@@ -173,13 +180,6 @@ private:
      */
     Drawable* clone(NodeCloneContext& context);
 
-    /**
-     * Sets the MeshSkin for this model.
-     *
-     * @param skin The MeshSkin for this model.
-     */
-    void setSkin(MeshSkin* skin);
-
     /**
      * Sets the specified material's node binding to this model's node.
      */
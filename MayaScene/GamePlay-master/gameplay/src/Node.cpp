@@ -26,7 +26,7 @@ namespace gameplay
 Node::Node(const char* id)
     : _scene(NULL), _firstChild(NULL), _nextSibling(NULL), _prevSibling(NULL), _parent(NULL), _childCount(0), _enabled(true), _tags(NULL),
     _drawable(NULL), _camera(NULL), _light(NULL), _audioSource(NULL), _collisionObject(NULL), _agent(NULL), _userObject(NULL),
-      _dirtyBits(NODE_DIRTY_ALL)
+      _cachedWorld(NULL), _dirtyBits(NODE_DIRTY_ALL)
 {
     GP_REGISTER_SCRIPT_EVENTS();
     if (id)
@@ -72,7 +72,15 @@ void Node::setId(const char* id)
 {
     if (id)
     {
+        // Keep the scene's ID index current
+        Scene* scene = getScene();
+        if (scene)
+            scene->unindexNode(this, false);
+
         _id = id;
+
+        if (scene)
+            scene->indexNode(this, false);
     }
 }
 
@@ -122,6 +130,13 @@ void Node::addChild(Node* child)
     ++_childCount;
     setBoundsDirty();
 
+    Scene* scene = getScene();
+    if (scene)
+    {
+        scene->indexNode(child, true);
+        scene->hierarchyChanged();
+    }
+
     if (_dirtyBits & NODE_DIRTY_HIERARCHY)
     {
         hierarchyChanged();
@@ -153,6 +168,14 @@ void Node::removeAllChildren()
 
 void Node::remove()
 {
+    // Leaving the scene's hierarchy, along with our children.
+    Scene* scene = getScene();
+    if (scene)
+    {
+        scene->unindexNode(this, true);
+        scene->detachWorldMatrices(this);
+    }
+
     // Re-link our neighbours.
     if (_prevSibling)
     {
@@ -435,6 +458,10 @@ bool Node::isStatic() const
 
 const Matrix& Node::getWorldMatrix() const
 {
+    // Nodes in a scene keep their world matrix in the scene's contiguous array, which
+    // Scene::updateWorldMatrices brings up to date once per frame. This resolves it early.
+    Matrix& world = _cachedWorld ? *_cachedWorld : _world;
+
     if (_dirtyBits & NODE_DIRTY_WORLD)
     {
         // Clear our dirty flag immediately to prevent this block from being entered if our
@@ -448,11 +475,11 @@ const Matrix& Node::getWorldMatrix() const
             Node* parent = getParent();
             if (parent && (!_collisionObject || _collisionObject->isKinematic()))
             {
-                Matrix::multiply(parent->getWorldMatrix(), getMatrix(), &_world);
+                Matrix::multiply(parent->getWorldMatrix(), getMatrix(), &world);
             }
             else
             {
-                _world = getMatrix();
+                world = getMatrix();
             }
 
             // Our world matrix was just updated, so call getWorldMatrix() on all child nodes
@@ -463,7 +490,32 @@ const Matrix& Node::getWorldMatrix() const
             }
         }
     }
-    return _world;
+    return world;
+}
+
+void Node::updateWorldMatrix(const Matrix* parentWorld, Matrix* local) const
+{
+    GP_ASSERT(_cachedWorld);
+
+    if (!(_dirtyBits & NODE_DIRTY_WORLD))
+        return;
+
+    _dirtyBits &= ~NODE_DIRTY_WORLD;
+
+    // Same rules as getWorldMatrix(): static nodes keep the world matrix they have,
+    // and only kinematic collision objects follow their parent.
+    if (isStatic())
+        return;
+
+    *local = getMatrix();
+    if (parentWorld && (!_collisionObject || _collisionObject->isKinematic()))
+    {
+        Matrix::multiply(*parentWorld, *local, _cachedWorld);
+    }
+    else
+    {
+        *_cachedWorld = *local;
+    }
 }
 
 const Matrix& Node::getWorldViewMatrix() const
@@ -1016,7 +1068,7 @@ void Node::cloneInto(Node* node, NodeCloneContext& context) const
         node->_tags = new std::map<std::string, std::string>(_tags->begin(), _tags->end());
     }
 
-    node->_world = _world;
+    node->_world = _cachedWorld ? *_cachedWorld : _world;
     node->_bounds = _bounds;
 
     // TODO: Clone the rest of the node data.
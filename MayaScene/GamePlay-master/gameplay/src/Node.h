@@ -665,6 +665,15 @@ protected:
      */
     void setBoundsDirty();
 
+    /**
+     * Resolves the world matrix into its scene's slot when dirty, used by Scene::updateWorldMatrices.
+     * Static and physics nodes follow the same rules as getWorldMatrix.
+     *
+     * @param parentWorld The parent's current world matrix, or NULL for a top level node.
+     * @param local Where the local matrix is stored along the way.
+     */
+    void updateWorldMatrix(const Matrix* parentWorld, Matrix* local) const;
+
     /**
      * Returns the first child node that matches the given ID.
      *
@@ -746,8 +755,10 @@ protected:
     mutable AIAgent* _agent;
     /** The user object component attached to this node. */
     Ref* _userObject;
-    /** The world matrix for this node. */
+    /** The world matrix for this node, while it isn't kept by its scene. */
     mutable Matrix _world;
+    /** The node's slot in its scene's world matrices, see Scene::updateWorldMatrices. NULL outside a scene. */
+    Matrix* _cachedWorld;
     /** The bounding sphere for this node. */
     mutable BoundingSphere _bounds;
     /** The dirty bits used for optimization. */
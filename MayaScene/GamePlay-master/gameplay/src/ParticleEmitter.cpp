@@ -5,17 +5,51 @@
 #include "Scene.h"
 #include "Quaternion.h"
 #include "Properties.h"
+#include "MathUtil.h"
+#include "ThreadPool.h"
 
 #define PARTICLE_COUNT_MAX                       100
 #define PARTICLE_EMISSION_RATE                   10
 #define PARTICLE_EMISSION_RATE_TIME_INTERVAL     1000.0f / (float)PARTICLE_EMISSION_RATE
 #define PARTICLE_UPDATE_RATE_MAX                 8
+#define PARTICLE_STREAM_COUNT                    34
+#define PARTICLE_UPDATE_THREAD_MIN               16384
 
 namespace gameplay
 {
 
+// Stores v as particle index of the component arrays dst.
+static void setComponents(float* const* dst, unsigned int index, const Vector3& v)
+{
+    dst[0][index] = v.x;
+    dst[1][index] = v.y;
+    dst[2][index] = v.z;
+}
+
+static void setComponents(float* const* dst, unsigned int index, const Vector4& v)
+{
+    dst[0][index] = v.x;
+    dst[1][index] = v.y;
+    dst[2][index] = v.z;
+    dst[3][index] = v.w;
+}
+
+// Rotates particle index of the component arrays v about the unit axis (x, y, z), by the angle of cosine c and sine s.
+static void rotateComponents(float* const* v, unsigned int index, float x, float y, float z, float c, float s)
+{
+    const float vx = v[0][index];
+    const float vy = v[1][index];
+    const float vz = v[2][index];
+
+    // Rodrigues' rotation formula, the same rotation as Matrix::createRotation without building the matrix.
+    const float d = (x * vx + y * vy + z * vz) * (1.0f - c);
+    v[0][index] = vx * c + (y * vz - z * vy) * s + x * d;
+    v[1][index] = vy * c + (z * vx - x * vz) * s + y * d;
+    v[2][index] = vz * c + (x * vy - y * vx) * s + z * d;
+}
+
 ParticleEmitter::ParticleEmitter(unsigned int particleCountMax) : Drawable(),
-    _particleCountMax(particleCountMax), _particleCount(0), _particles(NULL),
+    _particleCountMax(particleCountMax), _particleCount(0), _particleData(NULL), _particleStride(0),
     _emissionRate(PARTICLE_EMISSION_RATE), _started(false), _ellipsoid(false),
     _sizeStartMin(1.0f), _sizeStartMax(1.0f), _sizeEndMin(1.0f), _sizeEndMax(1.0f),
     _energyMin(1000L), _energyMax(1000L),
@@ -25,20 +59,20 @@ ParticleEmitter::ParticleEmitter(unsigned int particleCountMax) : Drawable(),
     _acceleration(Vector3::zero()), _accelerationVar(Vector3::zero()),
     _rotationPerParticleSpeedMin(0.0f), _rotationPerParticleSpeedMax(0.0f),
     _rotationSpeedMin(0.0f), _rotationSpeedMax(0.0f),
-    _rotationAxis(Vector3::zero()), _rotation(Matrix::identity()),
+    _rotationAxis(Vector3::zero()),
     _spriteBatch(NULL), _spriteBlendMode(BLEND_ALPHA),  _spriteTextureWidth(0), _spriteTextureHeight(0), _spriteTextureWidthRatio(0), _spriteTextureHeightRatio(0), _spriteTextureCoords(NULL),
     _spriteAnimated(false),  _spriteLooped(false), _spriteFrameCount(1), _spriteFrameRandomOffset(0),_spriteFrameDuration(0L), _spriteFrameDurationSecs(0.0f), _spritePercentPerFrame(0.0f),
     _orbitPosition(false), _orbitVelocity(false), _orbitAcceleration(false),
     _timePerEmission(PARTICLE_EMISSION_RATE_TIME_INTERVAL), _emitTime(0), _lastUpdated(0)
 {
     GP_ASSERT(particleCountMax);
-    _particles = new Particle[particleCountMax];
+    createParticles();
 }
 
 ParticleEmitter::~ParticleEmitter()
 {
     SAFE_DELETE(_spriteBatch);
-    SAFE_DELETE_ARRAY(_particles);
+    SAFE_DELETE_ARRAY(_particleData);
     SAFE_DELETE_ARRAY(_spriteTextureCoords);
 }
 
@@ -300,7 +334,7 @@ bool ParticleEmitter::isActive() const
 void ParticleEmitter::emitOnce(unsigned int particleCount)
 {
     GP_ASSERT(_node);
-    GP_ASSERT(_particles);
+    GP_ASSERT(_particleData);
 
     // Limit particleCount so as not to go over _particleCountMax.
     if (particleCount + _particleCount > _particleCountMax)
@@ -309,7 +343,8 @@ void ParticleEmitter::emitOnce(unsigned int particleCount)
     }
 
     Vector3 translation;
-    Matrix world = _node->getWorldMatrix();
+    const Matrix& nodeWorld = _node->getWorldMatrix();
+    Matrix world = nodeWorld;
     world.getTranslation(&translation);
 
     // Take translation out of world matrix so it can be used to rotate orbiting properties.
@@ -317,67 +352,106 @@ void ParticleEmitter::emitOnce(unsigned int particleCount)
     world.m[13] = 0.0f;
     world.m[14] = 0.0f;
 
+    const unsigned int firstParticle = _particleCount;
+    Particles& p = _particles;
+
     // Emit the new particles.
     for (unsigned int i = 0; i < particleCount; i++)
     {
-        Particle* p = &_particles[_particleCount];
-
-        generateColor(_colorStart, _colorStartVar, &p->_colorStart);
-        generateColor(_colorEnd, _colorEndVar, &p->_colorEnd);
-        p->_color.set(p->_colorStart);
-
-        p->_energy = p->_energyStart = generateScalar(_energyMin, _energyMax);
-        p->_size = p->_sizeStart = generateScalar(_sizeStartMin, _sizeStartMax);
-        p->_sizeEnd = generateScalar(_sizeEndMin, _sizeEndMax);
-        p->_rotationPerParticleSpeed = generateScalar(_rotationPerParticleSpeedMin, _rotationPerParticleSpeedMax);
-        p->_angle = generateScalar(0.0f, p->_rotationPerParticleSpeed);
-        p->_rotationSpeed = generateScalar(_rotationSpeedMin, _rotationSpeedMax);
+        const unsigned int index = _particleCount;
+
+        Vector4 colorStart;
+        Vector4 colorEnd;
+        generateColor(_colorStart, _colorStartVar, &colorStart);
+        generateColor(_colorEnd, _colorEndVar, &colorEnd);
+        setComponents(p._colorStart, index, colorStart);
+        setComponents(p._colorEnd, index, colorEnd);
+        setComponents(p._color, index, colorStart);
+
+        p._energy[index] = p._energyStart[index] = generateScalar(_energyMin, _energyMax);
+        p._size[index] = p._sizeStart[index] = generateScalar(_sizeStartMin, _sizeStartMax);
+        p._sizeEnd[index] = generateScalar(_sizeEndMin, _sizeEndMax);
+        p._rotationPerParticleSpeed[index] = generateScalar(_rotationPerParticleSpeedMin, _rotationPerParticleSpeedMax);
+        p._angle[index] = generateScalar(0.0f, p._rotationPerParticleSpeed[index]);
+        p._rotationSpeed[index] = generateScalar(_rotationSpeedMin, _rotationSpeedMax);
 
         // Only initial position can be generated within an ellipsoidal domain.
-        generateVector(_position, _positionVar, &p->_position, _ellipsoid);
-        generateVector(_velocity, _velocityVar, &p->_velocity, false);
-        generateVector(_acceleration, _accelerationVar, &p->_acceleration, false);
-        generateVector(_rotationAxis, _rotationAxisVar, &p->_rotationAxis, false);
-
-        // Initial position, velocity and acceleration can all be relative to the emitter's transform.
-        // Rotate specified properties by the node's rotation.
-        if (_orbitPosition)
+        Vector3 position;
+        Vector3 velocity;
+        Vector3 acceleration;
+        Vector3 rotationAxis;
+        generateVector(_position, _positionVar, &position, _ellipsoid);
+        generateVector(_velocity, _velocityVar, &velocity, false);
+        generateVector(_acceleration, _accelerationVar, &acceleration, false);
+        generateVector(_rotationAxis, _rotationAxisVar, &rotationAxis, false);
+
+        // The rotation axis always orbits the node. It's normalized once here rather than on every update.
+        if (p._rotationSpeed[index] != 0.0f && !rotationAxis.isZero())
         {
-            world.transformPoint(p->_position, &p->_position);
+            world.transformPoint(&rotationAxis);
+            rotationAxis.normalize();
         }
 
-        if (_orbitVelocity)
-        {
-            world.transformPoint(p->_velocity, &p->_velocity);
-        }
-
-        if (_orbitAcceleration)
-        {
-            world.transformPoint(p->_acceleration, &p->_acceleration);
-        }
-
-        // The rotation axis always orbits the node.
-        if (p->_rotationSpeed != 0.0f && !p->_rotationAxis.isZero())
-        {
-            world.transformPoint(p->_rotationAxis, &p->_rotationAxis);
-        }
-
-        // Translate position relative to the node's world space.
-        p->_position.add(translation);
+        setComponents(p._position, index, position);
+        setComponents(p._velocity, index, velocity);
+        setComponents(p._acceleration, index, acceleration);
+        setComponents(p._rotationAxis, index, rotationAxis);
 
         // Initial sprite frame.
         if (_spriteFrameRandomOffset > 0)
         {
-            p->_frame = rand() % _spriteFrameRandomOffset;
+            p._frame[index] = rand() % _spriteFrameRandomOffset;
         }
         else
         {
-            p->_frame = 0;
+            p._frame[index] = 0;
         }
-        p->_timeOnCurrentFrame = 0.0f;
+        p._timeOnCurrentFrame[index] = 0.0f;
 
         ++_particleCount;
     }
+
+    if (particleCount == 0)
+    {
+        return;
+    }
+
+    // Initial position, velocity and acceleration can all be relative to the emitter's transform.
+    // Rotate specified properties of all new particles at once by the node's rotation.
+    float* x = p._position[0] + firstParticle;
+    float* y = p._position[1] + firstParticle;
+    float* z = p._position[2] + firstParticle;
+
+    // Translate position relative to the node's world space, in the same pass when orbiting.
+    if (_orbitPosition)
+    {
+        nodeWorld.transformPoints(x, y, z, particleCount, x, y, z);
+    }
+    else
+    {
+        for (unsigned int i = 0; i < particleCount; i++)
+        {
+            x[i] += translation.x;
+            y[i] += translation.y;
+            z[i] += translation.z;
+        }
+    }
+
+    if (_orbitVelocity)
+    {
+        x = p._velocity[0] + firstParticle;
+        y = p._velocity[1] + firstParticle;
+        z = p._velocity[2] + firstParticle;
+        world.transformVectors(x, y, z, particleCount, x, y, z);
+    }
+
+    if (_orbitAcceleration)
+    {
+        x = p._acceleration[0] + firstParticle;
+        y = p._acceleration[1] + firstParticle;
+        z = p._acceleration[2] + firstParticle;
+        world.transformVectors(x, y, z, particleCount, x, y, z);
+    }
 }
 
 unsigned int ParticleEmitter::getParticlesCount() const
@@ -863,14 +937,13 @@ void ParticleEmitter::update(float elapsedTime)
 
     // Cap particle updates at a maximum rate. This saves processing
     // and also improves precision since updating with very small
-    // time increments is more lossy.
-    static double runningTime = 0;
-    runningTime += elapsedTime;
-    if (runningTime < PARTICLE_UPDATE_RATE_MAX)
-        return;    
+    // time increments is more lossy. Every emitter keeps its own time.
+    _lastUpdated += elapsedTime;
+    if (_lastUpdated < PARTICLE_UPDATE_RATE_MAX)
+        return;
 
-    float elapsedMs = runningTime;
-    runningTime = 0;
+    float elapsedMs = _lastUpdated;
+    _lastUpdated = 0;
 
     float elapsedSecs = elapsedMs * 0.001f;
 
@@ -893,92 +966,195 @@ void ParticleEmitter::update(float elapsedTime)
         }
     }
 
-    // Now update all currently living particles.
-    GP_ASSERT(_particles);
-    for (unsigned int particlesIndex = 0; particlesIndex < _particleCount; ++particlesIndex)
+    // Now update all currently living particles, large emitters split them over the ThreadPool in whole SIMD registers.
+    GP_ASSERT(_particleData);
+    ThreadPool::parallelFor(_particleCount, PARTICLE_UPDATE_THREAD_MIN, [this, elapsedMs, elapsedSecs](unsigned int begin, unsigned int end)
     {
-        Particle* p = &_particles[particlesIndex];
-        p->_energy -= elapsedMs;
+        updateParticles(begin, end, elapsedMs, elapsedSecs);
+    }, 4);
 
-        if (p->_energy > 0L)
+    for (unsigned int particlesIndex = 0; particlesIndex < _particleCount; )
+    {
+        if (_particles._energy[particlesIndex] > 0.0f)
         {
-            if (p->_rotationSpeed != 0.0f && !p->_rotationAxis.isZero())
-            {
-                Matrix::createRotation(p->_rotationAxis, p->_rotationSpeed * elapsedSecs, &_rotation);
+            ++particlesIndex;
+            continue;
+        }
 
-                _rotation.transformPoint(p->_velocity, &p->_velocity);
-                _rotation.transformPoint(p->_acceleration, &p->_acceleration);
-            }
+        // Particle is dead.  Move the particle furthest from the start of the array
+        // down to take its place, and re-use the slot at the end of the list of living particles.
+        if (particlesIndex != _particleCount - 1)
+        {
+            copyParticle(_particleCount - 1, particlesIndex);
+        }
+        --_particleCount;
+    }
+}
 
-            // Particle is still alive.
-            p->_velocity.x += p->_acceleration.x * elapsedSecs;
-            p->_velocity.y += p->_acceleration.y * elapsedSecs;
-            p->_velocity.z += p->_acceleration.z * elapsedSecs;
+void ParticleEmitter::updateParticles(unsigned int begin, unsigned int end, float elapsedMs, float elapsedSecs)
+{
+    Particles& p = _particles;
 
-            p->_position.x += p->_velocity.x * elapsedSecs;
-            p->_position.y += p->_velocity.y * elapsedSecs;
-            p->_position.z += p->_velocity.z * elapsedSecs;
+    // Rotating particles turn their velocity and acceleration about their own axis.
+    for (unsigned int i = begin; i < end; ++i)
+    {
+        const float speed = p._rotationSpeed[i];
+        const float x = p._rotationAxis[0][i];
+        const float y = p._rotationAxis[1][i];
+        const float z = p._rotationAxis[2][i];
+        if (speed == 0.0f || (x == 0.0f && y == 0.0f && z == 0.0f))
+            continue;
+
+        const float angle = speed * elapsedSecs;
+        const float c = cos(angle);
+        const float s = sin(angle);
+        rotateComponents(p._velocity, i, x, y, z, c, s);
+        rotateComponents(p._acceleration, i, x, y, z, c, s);
+    }
 
-            p->_angle += p->_rotationPerParticleSpeed * elapsedSecs;
+    // Integration and the linear interpolation of color and size, on all particles alike.
+    // Particles that die here are integrated for nothing, update() removes them afterwards.
+    unsigned int i = begin;
 
-            // Simple linear interpolation of color and size.
-            float percent = 1.0f - ((float)p->_energy / (float)p->_energyStart);
+#ifdef GP_USE_SSE
+    const __m128 ms = _mm_set1_ps(elapsedMs);
+    const __m128 dt = _mm_set1_ps(elapsedSecs);
+    const __m128 one = _mm_set1_ps(1.0f);
 
-            p->_color.x = p->_colorStart.x + (p->_colorEnd.x - p->_colorStart.x) * percent;
-            p->_color.y = p->_colorStart.y + (p->_colorEnd.y - p->_colorStart.y) * percent;
-            p->_color.z = p->_colorStart.z + (p->_colorEnd.z - p->_colorStart.z) * percent;
-            p->_color.w = p->_colorStart.w + (p->_colorEnd.w - p->_colorStart.w) * percent;
+    for (; i + 4 <= end; i += 4)
+    {
+        const __m128 energy = _mm_sub_ps(_mm_loadu_ps(&p._energy[i]), ms);
+        _mm_storeu_ps(&p._energy[i], energy);
 
-            p->_size = p->_sizeStart + (p->_sizeEnd - p->_sizeStart) * percent;
+        for (int k = 0; k < 3; ++k)
+        {
+            const __m128 velocity = _mm_add_ps(_mm_loadu_ps(&p._velocity[k][i]), _mm_mul_ps(_mm_loadu_ps(&p._acceleration[k][i]), dt));
+            _mm_storeu_ps(&p._velocity[k][i], velocity);
+            _mm_storeu_ps(&p._position[k][i], _mm_add_ps(_mm_loadu_ps(&p._position[k][i]), _mm_mul_ps(velocity, dt)));
+        }
 
-            // Handle sprite animations.
-            if (_spriteAnimated)
+        _mm_storeu_ps(&p._angle[i], _mm_add_ps(_mm_loadu_ps(&p._angle[i]), _mm_mul_ps(_mm_loadu_ps(&p._rotationPerParticleSpeed[i]), dt)));
+
+        const __m128 percent = _mm_sub_ps(one, _mm_div_ps(energy, _mm_loadu_ps(&p._energyStart[i])));
+
+        for (int k = 0; k < 4; ++k)
+        {
+            const __m128 start = _mm_loadu_ps(&p._colorStart[k][i]);
+            const __m128 range = _mm_sub_ps(_mm_loadu_ps(&p._colorEnd[k][i]), start);
+            _mm_storeu_ps(&p._color[k][i], _mm_add_ps(start, _mm_mul_ps(range, percent)));
+        }
+
+        const __m128 sizeStart = _mm_loadu_ps(&p._sizeStart[i]);
+        const __m128 sizeRange = _mm_sub_ps(_mm_loadu_ps(&p._sizeEnd[i]), sizeStart);
+        _mm_storeu_ps(&p._size[i], _mm_add_ps(sizeStart, _mm_mul_ps(sizeRange, percent)));
+    }
+#endif
+
+    for (; i < end; ++i)
+    {
+        p._energy[i] -= elapsedMs;
+
+        for (int k = 0; k < 3; ++k)
+        {
+            p._velocity[k][i] += p._acceleration[k][i] * elapsedSecs;
+            p._position[k][i] += p._velocity[k][i] * elapsedSecs;
+        }
+
+        p._angle[i] += p._rotationPerParticleSpeed[i] * elapsedSecs;
+
+        const float percent = 1.0f - (p._energy[i] / p._energyStart[i]);
+
+        for (int k = 0; k < 4; ++k)
+        {
+            p._color[k][i] = p._colorStart[k][i] + (p._colorEnd[k][i] - p._colorStart[k][i]) * percent;
+        }
+
+        p._size[i] = p._sizeStart[i] + (p._sizeEnd[i] - p._sizeStart[i]) * percent;
+    }
+
+    // Handle sprite animations.
+    if (!_spriteAnimated)
+        return;
+
+    for (i = begin; i < end; ++i)
+    {
+        if (!_spriteLooped)
+        {
+            // The last frame should finish exactly when the particle dies.
+            const float percent = 1.0f - (p._energy[i] / p._energyStart[i]);
+            float percentSpent = 0.0f;
+            for (unsigned int frame = 0; frame < p._frame[i]; frame++)
             {
-                if (!_spriteLooped)
-                {
-                    // The last frame should finish exactly when the particle dies.
-                    float percentSpent = 0.0f;
-                    for (unsigned int i = 0; i < p->_frame; i++)
-                    {
-                        percentSpent += _spritePercentPerFrame;
-                    }
-                    p->_timeOnCurrentFrame = percent - percentSpent;
-                    if (p->_frame < _spriteFrameCount - 1 &&
-                        p->_timeOnCurrentFrame >= _spritePercentPerFrame)
-                    {
-                        ++p->_frame;
-                    }
-                }
-                else
-                {
-                    // _spriteFrameDurationSecs is an absolute time measured in seconds,
-                    // and the animation repeats indefinitely.
-                    p->_timeOnCurrentFrame += elapsedSecs;
-                    if (p->_timeOnCurrentFrame >= _spriteFrameDurationSecs)
-                    {
-                        p->_timeOnCurrentFrame -= _spriteFrameDurationSecs;
-                        ++p->_frame;
-                        if (p->_frame == _spriteFrameCount)
-                        {
-                            p->_frame = 0;
-                        }
-                    }
-                }
+                percentSpent += _spritePercentPerFrame;
+            }
+            p._timeOnCurrentFrame[i] = percent - percentSpent;
+            if (p._frame[i] < _spriteFrameCount - 1 &&
+                p._timeOnCurrentFrame[i] >= _spritePercentPerFrame)
+            {
+                ++p._frame[i];
             }
         }
         else
         {
-            // Particle is dead.  Move the particle furthest from the start of the array
-            // down to take its place, and re-use the slot at the end of the list of living particles.
-            if (particlesIndex != _particleCount - 1)
+            // _spriteFrameDurationSecs is an absolute time measured in seconds,
+            // and the animation repeats indefinitely.
+            p._timeOnCurrentFrame[i] += elapsedSecs;
+            if (p._timeOnCurrentFrame[i] >= _spriteFrameDurationSecs)
             {
-                _particles[particlesIndex] = _particles[_particleCount - 1];
+                p._timeOnCurrentFrame[i] -= _spriteFrameDurationSecs;
+                ++p._frame[i];
+                if (p._frame[i] == _spriteFrameCount)
+                {
+                    p._frame[i] = 0;
+                }
             }
-            --_particleCount;
         }
     }
 }
 
+void ParticleEmitter::createParticles()
+{
+    Particles& p = _particles;
+    float** streams[] =
+    {
+        &p._position[0], &p._position[1], &p._position[2],
+        &p._velocity[0], &p._velocity[1], &p._velocity[2],
+        &p._acceleration[0], &p._acceleration[1], &p._acceleration[2],
+        &p._colorStart[0], &p._colorStart[1], &p._colorStart[2], &p._colorStart[3],
+        &p._colorEnd[0], &p._colorEnd[1], &p._colorEnd[2], &p._colorEnd[3],
+        &p._color[0], &p._color[1], &p._color[2], &p._color[3],
+        &p._rotationPerParticleSpeed,
+        &p._rotationAxis[0], &p._rotationAxis[1], &p._rotationAxis[2],
+        &p._rotationSpeed, &p._angle,
+        &p._energyStart, &p._energy,
+        &p._sizeStart, &p._sizeEnd, &p._size,
+        &p._timeOnCurrentFrame
+    };
+    const unsigned int streamCount = sizeof(streams) / sizeof(streams[0]);
+
+    // The frames are the last array.
+    GP_ASSERT(streamCount + 1 == PARTICLE_STREAM_COUNT);
+
+    // Rounded up to whole SIMD registers, so every array is aligned like the first.
+    _particleStride = (_particleCountMax + 3) & ~3u;
+    _particleData = new float[_particleStride * PARTICLE_STREAM_COUNT];
+
+    for (unsigned int i = 0; i < streamCount; i++)
+    {
+        *streams[i] = _particleData + i * _particleStride;
+    }
+    p._frame = (unsigned int*)(_particleData + streamCount * _particleStride);
+}
+
+void ParticleEmitter::copyParticle(unsigned int src, unsigned int dst)
+{
+    for (unsigned int i = 0; i < PARTICLE_STREAM_COUNT; i++)
+    {
+        float* stream = _particleData + i * _particleStride;
+        memcpy(&stream[dst], &stream[src], sizeof(float));
+    }
+}
+
 unsigned int ParticleEmitter::draw(bool wireframe)
 {
     if (!isActive())
@@ -987,7 +1163,7 @@ unsigned int ParticleEmitter::draw(bool wireframe)
     if (_particleCount > 0)
     {
         GP_ASSERT(_spriteBatch);
-        GP_ASSERT(_particles);
+        GP_ASSERT(_particleData);
         GP_ASSERT(_spriteTextureCoords);
 
         // Set our node's view projection matrix to this emitter's effect.
@@ -1011,13 +1187,16 @@ unsigned int ParticleEmitter::draw(bool wireframe)
         Vector3 up;
         cameraWorldMatrix.getUpVector(&up);
 
+        const Particles& p = _particles;
         for (unsigned int i = 0; i < _particleCount; i++)
         {
-            Particle* p = &_particles[i];
+            const Vector3 position(p._position[0][i], p._position[1][i], p._position[2][i]);
+            const Vector4 color(p._color[0][i], p._color[1][i], p._color[2][i], p._color[3][i]);
+            const unsigned int frame = p._frame[i];
 
-            _spriteBatch->draw(p->_position, right, up, p->_size, p->_size,
-                                _spriteTextureCoords[p->_frame * 4], _spriteTextureCoords[p->_frame * 4 + 1], _spriteTextureCoords[p->_frame * 4 + 2], _spriteTextureCoords[p->_frame * 4 + 3],
-                                p->_color, pivot, p->_angle);
+            _spriteBatch->draw(position, right, up, p._size[i], p._size[i],
+                                _spriteTextureCoords[frame * 4], _spriteTextureCoords[frame * 4 + 1], _spriteTextureCoords[frame * 4 + 2], _spriteTextureCoords[frame * 4 + 3],
+                                color, pivot, p._angle[i]);
         }
 
         // Render.
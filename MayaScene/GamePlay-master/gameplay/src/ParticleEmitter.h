@@ -766,34 +766,47 @@ private:
     static ParticleEmitter::BlendMode getBlendModeFromString(const char* src);
 
     /**
-     * Defines the data for a single particle in the system.
+     * Defines the data of the particles in the system, one array per component
+     * so the update can process several particles at once.
+     * All arrays live in a single allocation, _particleStride floats apart.
      */
-    class Particle
+    class Particles
     {
 
     public:
-        Vector3 _position;
-        Vector3 _velocity;
-        Vector3 _acceleration;
-        Vector4 _colorStart;
-        Vector4 _colorEnd;
-        Vector4 _color;
-        float _rotationPerParticleSpeed;
-        Vector3 _rotationAxis;
-        float _rotationSpeed;
-        float _angle;
-        long _energyStart;
-        long _energy;
-        float _sizeStart;
-        float _sizeEnd;
-        float _size;
-        unsigned int _frame;
-        float _timeOnCurrentFrame;
+        float* _position[3];
+        float* _velocity[3];
+        float* _acceleration[3];
+        float* _colorStart[4];
+        float* _colorEnd[4];
+        float* _color[4];
+        float* _rotationPerParticleSpeed;
+        float* _rotationAxis[3];
+        float* _rotationSpeed;
+        float* _angle;
+        float* _energyStart;
+        float* _energy;
+        float* _sizeStart;
+        float* _sizeEnd;
+        float* _size;
+        float* _timeOnCurrentFrame;
+        unsigned int* _frame;
     };
 
+    // Allocates the arrays of _particles for _particleCountMax particles.
+    void createParticles();
+
+    // Copies every component of one particle over another.
+    void copyParticle(unsigned int src, unsigned int dst);
+
+    // Integrates and interpolates the particles in [begin, end), dead ones are left for update() to remove.
+    void updateParticles(unsigned int begin, unsigned int end, float elapsedMs, float elapsedSecs);
+
     unsigned int _particleCountMax;
     unsigned int _particleCount;
-    Particle* _particles;
+    Particles _particles;
+    float* _particleData;
+    unsigned int _particleStride;
     unsigned int _emissionRate;
     bool _started;
     bool _ellipsoid;
@@ -819,7 +832,6 @@ private:
     float _rotationSpeedMax;
     Vector3 _rotationAxis;
     Vector3 _rotationAxisVar;
-    Matrix _rotation;
     SpriteBatch* _spriteBatch;
     BlendMode _spriteBlendMode;
     float _spriteTextureWidth;
@@ -839,6 +851,7 @@ private:
     bool _orbitAcceleration;
     float _timePerEmission;
     float _emitTime;
+    // Time since the particles were last updated, in milliseconds.
     double _lastUpdated;
 };
 
@@ -6,6 +6,7 @@
 #include "Joint.h"
 #include "Terrain.h"
 #include "Bundle.h"
+#include "ThreadPool.h"
 
 namespace gameplay
 {
@@ -60,7 +61,7 @@ static bool endsWith(const char* str, const char* suffix, bool ignoreCase)
 
 
 Scene::Scene()
-    : _id(""), _activeCamera(NULL), _firstNode(NULL), _lastNode(NULL), _nodeCount(0), _bindAudioListenerToCamera(true), 
+    : _id(""), _activeCamera(NULL), _firstNode(NULL), _lastNode(NULL), _nodeCount(0), _flatHierarchyDirty(false), _bindAudioListenerToCamera(true), 
       _nextItr(NULL), _nextReset(true)
 {
     __sceneList.push_back(this);
@@ -221,6 +222,53 @@ void Scene::visitNode(Node* node, const char* visitMethod)
     }
 }
 
+Node* Scene::findNodeById(const char* id) const
+{
+    GP_ASSERT(id);
+
+    std::unordered_multimap<std::string, Node*>::const_iterator itr = _nodeIndex.find(id);
+    return itr != _nodeIndex.end() ? itr->second : NULL;
+}
+
+void Scene::indexNode(Node* node, bool recursive)
+{
+    GP_ASSERT(node);
+
+    _nodeIndex.insert(std::make_pair(node->_id, node));
+
+    if (recursive)
+    {
+        for (Node* child = node->getFirstChild(); child != NULL; child = child->getNextSibling())
+        {
+            indexNode(child, true);
+        }
+    }
+}
+
+void Scene::unindexNode(Node* node, bool recursive)
+{
+    GP_ASSERT(node);
+
+    typedef std::unordered_multimap<std::string, Node*>::iterator Iterator;
+    std::pair<Iterator, Iterator> range = _nodeIndex.equal_range(node->_id);
+    for (Iterator itr = range.first; itr != range.second; ++itr)
+    {
+        if (itr->second == node)
+        {
+            _nodeIndex.erase(itr);
+            break;
+        }
+    }
+
+    if (recursive)
+    {
+        for (Node* child = node->getFirstChild(); child != NULL; child = child->getNextSibling())
+        {
+            unindexNode(child, true);
+        }
+    }
+}
+
 Node* Scene::addNode(const char* id)
 {
     Node* node = Node::create(id);
@@ -270,6 +318,8 @@ void Scene::addNode(Node* node)
     }
 
     node->_scene = this;
+    indexNode(node, true);
+    hierarchyChanged();
 
     ++_nodeCount;
 
@@ -393,6 +443,125 @@ void Scene::update(float elapsedTime)
         if (node->isEnabled())
             node->update(elapsedTime);
     }
+
+    updateWorldMatrices();
+}
+
+// Fewer nodes than this per thread isn't worth handing to the ThreadPool.
+static const unsigned int MIN_NODES_PER_THREAD = 8192;
+
+void Scene::updateWorldMatrices()
+{
+    if (_flatHierarchyDirty)
+        flattenHierarchy();
+
+    const unsigned int count = (unsigned int)_flatNodes.size();
+    const unsigned int threadCount = std::min(ThreadPool::getThreadCount(), count / MIN_NODES_PER_THREAD);
+    if (threadCount <= 1)
+    {
+        updateWorldMatrices(0, count);
+        return;
+    }
+
+    // Top level subtrees don't depend on each other, each task takes a run of whole subtrees.
+    std::vector<unsigned int> ranges;
+    ranges.reserve(threadCount + 1);
+    ranges.push_back(0);
+
+    const unsigned int chunk = (count + threadCount - 1) / threadCount;
+    for (size_t i = 1; i < _flatSubtrees.size(); ++i)
+    {
+        const unsigned int end = _flatSubtrees[i];
+        if (end - ranges.back() >= chunk && ranges.size() < threadCount)
+        {
+            ranges.push_back(end);
+        }
+    }
+    ranges.push_back(count);
+
+    ThreadPool::run((unsigned int)ranges.size() - 1, [this, &ranges](unsigned int i)
+    {
+        updateWorldMatrices(ranges[i], ranges[i + 1]);
+    });
+}
+
+void Scene::updateWorldMatrices(unsigned int begin, unsigned int end)
+{
+    // Breadth-first within each subtree, parents are always resolved before their children.
+    for (unsigned int i = begin; i < end; ++i)
+    {
+        const int parent = _flatParents[i];
+        _flatNodes[i]->updateWorldMatrix(parent >= 0 ? &_worldMatrices[parent] : NULL, &_localMatrices[i]);
+    }
+}
+
+void Scene::hierarchyChanged()
+{
+    _flatHierarchyDirty = true;
+}
+
+void Scene::detachWorldMatrices(Node* node)
+{
+    GP_ASSERT(node);
+
+    if (node->_cachedWorld)
+    {
+        node->_world = *node->_cachedWorld;
+        node->_cachedWorld = NULL;
+    }
+
+    for (Node* child = node->getFirstChild(); child != NULL; child = child->getNextSibling())
+    {
+        detachWorldMatrices(child);
+    }
+
+    _flatHierarchyDirty = true;
+}
+
+void Scene::flattenHierarchy()
+{
+    std::vector<Node*> nodes;
+    std::vector<int> parents;
+    std::vector<unsigned int> subtrees;
+    nodes.reserve(_flatNodes.size());
+    parents.reserve(_flatNodes.size());
+
+    for (Node* root = _firstNode; root != NULL; root = root->_nextSibling)
+    {
+        subtrees.push_back((unsigned int)nodes.size());
+        nodes.push_back(root);
+        parents.push_back(-1);
+
+        // The subtree's nodes double as the breadth-first queue.
+        for (size_t head = subtrees.back(); head < nodes.size(); ++head)
+        {
+            for (Node* child = nodes[head]->getFirstChild(); child != NULL; child = child->getNextSibling())
+            {
+                nodes.push_back(child);
+                parents.push_back((int)head);
+            }
+        }
+    }
+
+    // World matrices move along with their nodes, the old array is still valid at this point.
+    std::vector<Matrix> worlds(nodes.size());
+    for (size_t i = 0; i < nodes.size(); ++i)
+    {
+        worlds[i] = nodes[i]->_cachedWorld ? *nodes[i]->_cachedWorld : nodes[i]->_world;
+    }
+
+    _flatNodes.swap(nodes);
+    _flatParents.swap(parents);
+    _flatSubtrees.swap(subtrees);
+    _worldMatrices.swap(worlds);
+    _localMatrices.resize(_flatNodes.size());
+
+    for (size_t i = 0; i < _flatNodes.size(); ++i)
+    {
+        _flatNodes[i]->_cachedWorld = &_worldMatrices[i];
+    }
+
+    _flatHierarchyDirty = false;
 }
 
 void Scene::reset()
@@ -17,6 +17,8 @@ namespace gameplay
  */
 class Scene : public Ref
 {
+    friend class Node;
+
 public:
 
     /**
@@ -90,6 +92,19 @@ public:
      */
     unsigned int findNodes(const char* id, std::vector<Node*>& nodes, bool recursive = true, bool exactMatch = true) const;
 
+    /**
+     * Returns a node anywhere in the scene's hierarchy whose ID exactly matches the given ID.
+     *
+     * Uses an index kept current by addNode, removeNode, Node::addChild, Node::removeChild and Node::setId,
+     * so the lookup is constant time. Nodes only reachable through a MeshSkin's joint hierarchy are not indexed.
+     * If several nodes share the ID, any one of them is returned.
+     *
+     * @param id The ID of the node to find.
+     *
+     * @return The node found, or NULL if there is none.
+     */
+    Node* findNodeById(const char* id) const;
+
     /**
      * Creates and adds a new node to the scene.
      *
@@ -188,6 +203,21 @@ public:
      */
     void update(float elapsedTime);
 
+    /**
+     * Brings the world matrix of every node in the scene up to date.
+     *
+     * The scene keeps its hierarchy flattened: one range per top level node, each in
+     * breadth-first order, with parent indices and the local and world matrices in
+     * contiguous arrays. Dirty nodes are resolved in a single pass over those arrays
+     * instead of Node::getWorldMatrix walking up and down the hierarchy per node,
+     * and large scenes spread the top level subtrees over multiple threads.
+     *
+     * Node::getWorldMatrix reads the results. It still resolves nodes changed after
+     * this pass on its own. This is called by update(float), call it once per frame
+     * before drawing when the scene isn't otherwise updated.
+     */
+    void updateWorldMatrices();
+
     /**
      * Visits each node in the scene and calls the specified method pointer.
      *
@@ -297,6 +327,36 @@ private:
 
     Node* findNextVisibleSibling(Node* node);
 
+    /**
+     * Adds the node, and its descendants if recursive, to the ID index.
+     */
+    void indexNode(Node* node, bool recursive);
+
+    /**
+     * Removes the node, and its descendants if recursive, from the ID index.
+     */
+    void unindexNode(Node* node, bool recursive);
+
+    /**
+     * Nodes were added, the flattened hierarchy is rebuilt on the next updateWorldMatrices.
+     */
+    void hierarchyChanged();
+
+    /**
+     * Hands the node and its descendants their world matrices back, they're leaving the scene.
+     */
+    void detachWorldMatrices(Node* node);
+
+    /**
+     * Flattens the hierarchy into _flatNodes & co, see updateWorldMatrices.
+     */
+    void flattenHierarchy();
+
+    /**
+     * Resolves the dirty world matrices in [begin, end) of the flattened hierarchy.
+     */
+    void updateWorldMatrices(unsigned int begin, unsigned int end);
+
     bool isNodeVisible(Node* node);
 
     std::string _id;
@@ -304,6 +364,13 @@ private:
     Node* _firstNode;
     Node* _lastNode;
     unsigned int _nodeCount;
+    std::unordered_multimap<std::string, Node*> _nodeIndex;
+    std::vector<Node*> _flatNodes;
+    std::vector<int> _flatParents;
+    std::vector<unsigned int> _flatSubtrees;
+    std::vector<Matrix> _localMatrices;
+    std::vector<Matrix> _worldMatrices;
+    bool _flatHierarchyDirty;
     Vector3 _ambientColor;
     bool _bindAudioListenerToCamera;
     Node* _nextItr;
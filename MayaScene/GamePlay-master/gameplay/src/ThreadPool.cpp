@@ -0,0 +1,170 @@
+#include "Base.h"
+#include "ThreadPool.h"
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+
+namespace gameplay
+{
+
+// One run call, its tasks are claimed one index at a time by whoever gets there first.
+// It lives on the caller's stack, the caller returns only once no worker refers to it anymore.
+struct ThreadPoolBatch
+{
+    const std::function<void(unsigned int)>* task;
+    unsigned int count;
+    std::atomic<unsigned int> next;
+
+    // Guarded by the pool's mutex.
+    unsigned int done;
+    unsigned int workers;
+};
+
+class ThreadPoolWorkers
+{
+public:
+
+    ThreadPoolWorkers()
+        : _stopping(false)
+    {
+        const unsigned int hardwareThreads = std::max(1u, std::thread::hardware_concurrency());
+        for (unsigned int i = 1; i < hardwareThreads; ++i)
+        {
+            _threads.push_back(std::thread(&ThreadPoolWorkers::work, this));
+        }
+    }
+
+    ~ThreadPoolWorkers()
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _stopping = true;
+        }
+        _batchAdded.notify_all();
+
+        for (size_t i = 0; i < _threads.size(); ++i)
+        {
+            _threads[i].join();
+        }
+    }
+
+    unsigned int getThreadCount() const
+    {
+        return (unsigned int)_threads.size() + 1;
+    }
+
+    void run(ThreadPoolBatch& batch)
+    {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            _batches.push_back(&batch);
+        }
+        _batchAdded.notify_all();
+
+        // The caller works on its own batch too, then waits for the tasks the workers have claimed.
+        const unsigned int finished = process(batch);
+
+        std::unique_lock<std::mutex> lock(_mutex);
+        batch.done += finished;
+        _batchDone.wait(lock, [&batch] { return batch.done == batch.count && batch.workers == 0; });
+
+        // Still queued if no worker got to it before every task was claimed.
+        std::deque<ThreadPoolBatch*>::iterator queued = std::find(_batches.begin(), _batches.end(), &batch);
+        if (queued != _batches.end())
+        {
+            _batches.erase(queued);
+        }
+    }
+
+private:
+
+    // Runs tasks of batch until none are left to claim, returns how many ran.
+    static unsigned int process(ThreadPoolBatch& batch)
+    {
+        unsigned int finished = 0;
+        for (unsigned int i = batch.next++; i < batch.count; i = batch.next++)
+        {
+            (*batch.task)(i);
+            ++finished;
+        }
+        return finished;
+    }
+
+    void work()
+    {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (true)
+        {
+            _batchAdded.wait(lock, [this] { return _stopping || !_batches.empty(); });
+            if (_stopping)
+                return;
+
+            ThreadPoolBatch* batch = _batches.front();
+
+            // Every task is claimed, whoever claimed them finishes the batch.
+            if (batch->next.load() >= batch->count)
+            {
+                _batches.pop_front();
+                continue;
+            }
+
+            batch->workers++;
+            lock.unlock();
+
+            const unsigned int finished = process(*batch);
+
+            lock.lock();
+            batch->done += finished;
+            batch->workers--;
+            if (batch->done == batch->count && batch->workers == 0)
+            {
+                _batchDone.notify_all();
+            }
+        }
+    }
+
+    std::vector<std::thread> _threads;
+    std::deque<ThreadPoolBatch*> _batches;
+    bool _stopping;
+    std::mutex _mutex;
+    std::condition_variable _batchAdded;
+    std::condition_variable _batchDone;
+};
+
+static ThreadPoolWorkers& getWorkers()
+{
+    static ThreadPoolWorkers workers;
+    return workers;
+}
+
+ThreadPool::ThreadPool()
+{
+}
+
+unsigned int ThreadPool::getThreadCount()
+{
+    return getWorkers().getThreadCount();
+}
+
+void ThreadPool::run(unsigned int taskCount, const std::function<void(unsigned int)>& task)
+{
+    if (taskCount == 0)
+        return;
+
+    if (taskCount == 1)
+    {
+        task(0);
+        return;
+    }
+
+    ThreadPoolBatch batch;
+    batch.task = &task;
+    batch.count = taskCount;
+    batch.next = 0;
+    batch.done = 0;
+    batch.workers = 0;
+
+    getWorkers().run(batch);
+}
+
+}
@@ -0,0 +1,77 @@
+#ifndef THREADPOOL_H_
+#define THREADPOOL_H_
+
+#include <algorithm>
+#include <functional>
+
+namespace gameplay
+{
+
+/**
+ * Defines a pool of persistent worker threads for splitting per-frame work.
+ *
+ * The workers are started on first use and wait on a condition variable in between,
+ * so a frame only pays for waking them up rather than for creating threads.
+ * The calling thread always takes part in the work and returns once all of it is done.
+ * run may be called from several threads at once, and from within a task.
+ */
+class ThreadPool
+{
+public:
+
+    /**
+     * Gets the number of threads work is split over, the workers plus the calling thread.
+     *
+     * @return The thread count, at least 1.
+     */
+    static unsigned int getThreadCount();
+
+    /**
+     * Calls task(index) for every index in [0, taskCount) on the workers and the calling thread.
+     *
+     * Returns once every task has finished. A single task is run on the calling thread.
+     *
+     * @param taskCount The number of tasks.
+     * @param task The task to run, called concurrently for different indices.
+     */
+    static void run(unsigned int taskCount, const std::function<void(unsigned int)>& task);
+
+    /**
+     * Calls func(begin, end) over ranges covering [0, count), split over as many threads as the count warrants.
+     *
+     * @param count The number of items.
+     * @param minItemsPerThread Fewer items than this per thread aren't worth the hand-off, the range is then split less.
+     * @param func The function to call, with the range's begin and end.
+     * @param alignment Every range but the last starts on a multiple of this, e.g. whole SIMD registers.
+     */
+    template<typename Func>
+    static void parallelFor(unsigned int count, unsigned int minItemsPerThread, const Func& func, unsigned int alignment = 1);
+
+private:
+
+    ThreadPool();
+};
+
+template<typename Func>
+void ThreadPool::parallelFor(unsigned int count, unsigned int minItemsPerThread, const Func& func, unsigned int alignment)
+{
+    const unsigned int rangeCount = std::min(getThreadCount(), count / std::max(minItemsPerThread, 1u));
+    if (rangeCount <= 1)
+    {
+        func(0u, count);
+        return;
+    }
+
+    unsigned int chunk = (count + rangeCount - 1) / rangeCount;
+    chunk = (chunk + alignment - 1) / alignment * alignment;
+
+    run((count + chunk - 1) / chunk, [&](unsigned int i)
+    {
+        const unsigned int begin = i * chunk;
+        func(begin, std::min(count, begin + chunk));
+    });
+}
+
+}
+
+#endif
@@ -451,6 +451,23 @@ void Transform::set(const Transform& transform)
     dirty(DIRTY_TRANSLATION | DIRTY_ROTATION | DIRTY_SCALE);
 }
 
+void Transform::set(const Matrix& matrix)
+{
+    if (isStatic())
+        return;
+
+    if (!matrix.decompose(&_scale, &_rotation, &_translation))
+    {
+        // Zero scale, the rotation can't be recovered
+        _rotation.setIdentity();
+    }
+
+    // The matrix is already composed, only listeners need to know
+    _matrix = matrix;
+    _matrixDirtyBits &= ~(DIRTY_TRANSLATION | DIRTY_ROTATION | DIRTY_SCALE);
+    dirty(0);
+}
+
 void Transform::setIdentity()
 {
     if (isStatic())
@@ -504,6 +504,18 @@ public:
      */
     void set(const Transform& transform);
 
+    /**
+     * Sets this transform from a local matrix.
+     *
+     * The scale, rotation and translation are decomposed from the matrix, which is
+     * then used as is instead of being recomposed, and listeners are notified once.
+     * Setting many transforms between suspendTransformChanged and resumeTransformChanged
+     * notifies each node, and its children, only once for the whole batch.
+     *
+     * @param matrix The matrix to set this transform to.
+     */
+    void set(const Matrix& matrix);
+
     /**
      * Sets this transform to the identity transform.
      */
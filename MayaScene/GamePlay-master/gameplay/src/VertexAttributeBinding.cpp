@@ -9,6 +9,30 @@ namespace gameplay
 static GLuint __maxVertexAttribs = 0;
 static std::vector<VertexAttributeBinding*> __vertexAttributeBindingCache;
 
+static GLenum toGLType(VertexFormat::Type type)
+{
+    switch (type)
+    {
+    case VertexFormat::HALF_FLOAT:
+#if defined(GL_HALF_FLOAT)
+        return GL_HALF_FLOAT;
+#else
+        return GL_HALF_FLOAT_OES;
+#endif
+    case VertexFormat::BYTE:
+        return GL_BYTE;
+    case VertexFormat::UNSIGNED_BYTE:
+        return GL_UNSIGNED_BYTE;
+    case VertexFormat::SHORT:
+        return GL_SHORT;
+    case VertexFormat::UNSIGNED_SHORT:
+        return GL_UNSIGNED_SHORT;
+    case VertexFormat::FLOAT:
+    default:
+        return GL_FLOAT;
+    }
+}
+
 VertexAttributeBinding::VertexAttributeBinding() :
     _handle(0), _attributes(NULL), _mesh(NULL), _effect(NULL)
 {
@@ -198,10 +222,10 @@ VertexAttributeBinding* VertexAttributeBinding::create(Mesh* mesh, const VertexF
         else
         {
             void* pointer = vertexPointer ? (void*)(((unsigned char*)vertexPointer) + offset) : (void*)offset;
-            b->setVertexAttribPointer(attrib, (GLint)e.size, GL_FLOAT, GL_FALSE, (GLsizei)vertexFormat.getVertexSize(), pointer);
+            b->setVertexAttribPointer(attrib, (GLint)e.size, toGLType(e.type), e.normalized ? GL_TRUE : GL_FALSE, (GLsizei)vertexFormat.getVertexSize(), pointer);
         }
 
-        offset += e.size * sizeof(float);
+        offset += e.getByteSize();
     }
 
     if (b->_handle)
@@ -35,12 +35,27 @@ public:
         TEXCOORD7 = 15
     };
 
+    /**
+     * Defines the component types a vertex element can be stored as.
+     */
+    enum Type
+    {
+        FLOAT = 0,
+        HALF_FLOAT,
+        BYTE,
+        UNSIGNED_BYTE,
+        SHORT,
+        UNSIGNED_SHORT
+    };
+
     /**
      * Defines a single element within a vertex format.
      *
-     * All vertex elements are assumed to be of type float, but can
-     * have a varying number of float values (1-4), which is represented
-     * by the size attribute. Additionally, vertex elements are assumed
+     * Vertex elements default to type float, but can be stored as any
+     * of the component types in Type, and have a varying number of values
+     * (1-4), which is represented by the size attribute. Integer components
+     * can optionally be normalized to [0, 1] (unsigned) or [-1, 1] (signed)
+     * when read by the shader. Additionally, vertex elements are assumed
      * to be tightly packed.
      */
     class Element
@@ -56,6 +71,16 @@ public:
          */
         unsigned int size;
 
+        /**
+         * The component type of the values in the vertex element.
+         */
+        Type type;
+
+        /**
+         * Whether integer values are normalized when read by the shader.
+         */
+        bool normalized;
+
         /**
          * Constructor.
          */
@@ -65,9 +90,16 @@ public:
          * Constructor.
          *
          * @param usage The vertex element usage semantic.
-         * @param size The number of float values in the vertex element.
+         * @param size The number of values in the vertex element.
+         * @param type The component type of the values in the vertex element.
+         * @param normalized Whether integer values are normalized when read by the shader.
+         */
+        Element(Usage usage, unsigned int size, Type type = FLOAT, bool normalized = false);
+
+        /**
+         * Gets the size (in bytes) of this element.
          */
-        Element(Usage usage, unsigned int size);
+        unsigned int getByteSize() const;
 
         /**
          * Compares two vertex elements for equality.
@@ -145,6 +177,11 @@ public:
      */
     static const char* toString(Usage usage);
 
+    /**
+     * Returns the size (in bytes) of a single component of the specified type.
+     */
+    static unsigned int getTypeSize(Type type);
+
 private:
 
     std::vector<Element> _elements;
@@ -1,3 +1,48 @@
+#if defined(PACKED_VERTEX)
+
+// Dequantization range of a_position, the mesh's object space bounds
+uniform vec3 u_positionOffset;
+uniform vec3 u_positionScale;
+
+vec3 decodeOctahedral(vec2 e)
+{
+    vec3 v = vec3(e.xy, 1.0 - abs(e.x) - abs(e.y));
+    if (v.z < 0.0)
+    {
+        v.xy = (1.0 - abs(v.yx)) * vec2(v.x >= 0.0 ? 1.0 : -1.0, v.y >= 0.0 ? 1.0 : -1.0);
+    }
+    return normalize(v);
+}
+
+vec4 getPosition()
+{
+    return vec4(u_positionOffset + a_position.xyz * u_positionScale, 1.0);
+}
+
+#if defined(LIGHTING)
+
+vec3 getNormal()
+{
+    return decodeOctahedral(a_normal.xy);
+}
+
+#if defined(BUMPED)
+vec3 getTangent()
+{
+    return decodeOctahedral(a_tangent.xy);
+}
+
+vec3 getBinormal()
+{
+    // a_position.w holds the handedness of the tangent frame
+    return cross(getNormal(), getTangent()) * (a_position.w * 2.0 - 1.0);
+}
+#endif
+
+#endif
+
+#else
+
 vec4 getPosition()
 {
     return a_position;    
@@ -22,4 +67,6 @@ vec3 getBinormal()
 }
 #endif
 
-#endif
\ No newline at end of file
+#endif
+
+#endif
@@ -3,22 +3,38 @@
 // Declare our game instance
 MayaViewer game;
 
+// Id of the animation created from a node's ANIMATION_CLIP
+static const char* MAYA_CLIP_ID = "maya";
+
 static bool gKeys[256] = {};
 int gDeltaX;
 int gDeltaY;
 bool gMousePressed;
 
 MayaViewer::MayaViewer()
-	: _scene(NULL), _wireframe(false)
+	: _scene(NULL), _wireframe(false), receiver(NULL), statsFont(NULL), showStats(true)
 {
 	_CrtSetDbgFlag(_CRTDBG_ALLOC_MEM_DF | _CRTDBG_LEAK_CHECK_DF);
 }
 
 MayaViewer::~MayaViewer()
 {
+	// Stops the receive thread before its Comlib goes away
+	delete receiver;
 	delete consumerBuffer;
 	SAFE_RELEASE(light);
 
+	for (ReceivedMessage& message : deferredMessages)
+		delete[] message.data;
+	deferredMessages.clear();
+
+	for (auto& geometry : geometries)
+		SAFE_RELEASE(geometry.second.pMesh);
+	geometries.clear();
+
+	for (auto& material : materials)
+		releaseSharedParameters(material.second);
+
 	std::vector<Node*> nodes;
 	_scene->findNodes("", nodes, true, false);
 
@@ -36,6 +52,9 @@ void MayaViewer::initialize()
 {
 	consumerBuffer = new Comlib(L"Filemap", 150, ProcessType::Consumer);
 
+	receiver = new MessageReceiver(consumerBuffer);
+	receiver->start();
+
 	// Load game scene from file
 	_scene = Scene::create();
 
@@ -53,143 +72,363 @@ void MayaViewer::initialize()
 	light = Light::createPoint(Vector3(1.f, 1.0f, 1.0f), 50);
 	lightNode->setLight(light);
 	lightNode->translate(Vector3(0, 1, 5));
+
+	statsFont = Font::create("res/ui/arial.gpb");
+
+	textureLoader.start();
 }
 
 void MayaViewer::finalize()
 {
+	// Not left to the destructor, which runs after the GL context is gone
+	textureLoader.stop();
+	textureLoader.clear();
+
+	SAFE_RELEASE(statsFont);
 	SAFE_RELEASE(_scene);	
 }
 
 void MayaViewer::update(float elapsedTime)
 {
-	while (consumerBuffer->Recieve(msg, mainHeader))
+	pumpMessages();
+	textureLoader.update();
+
+	// Everything moved this frame in one pass, before culling & drawing read them
+	_scene->updateWorldMatrices();
+}
+
+void MayaViewer::setMessageBudget(float milliseconds, size_t bytes)
+{
+	messageTimeBudget = milliseconds;
+	messageByteBudget = bytes;
+}
+
+void MayaViewer::pumpMessages()
+{
+	const double start = getAbsoluteTime();
+	pumpStats = PumpStats();
+
+	// Takes everything the receive thread has decoded, transforms & cameras are cheap and handled right away.
+	// Stops once enough is deferred, the receiver and then the plugin wait instead of the viewer growing without bound.
+	// Nodes & their children are notified once for all of the frame's transforms, when resuming
+	Transform::suspendTransformChanged();
+
+	ReceivedMessage message;
+	while (deferredBytes < MAX_DEFERRED_BYTES && receiver->pop(message))
 	{
-		switch (mainHeader->header)
-		{
-		default:
-			break;
+		pumpStats.received++;
 
-		case MESH_NEW:
+		if (isPriority(message))
 		{
-			MeshInfoHeader meshInfo;
-			memcpy(&meshInfo, msg, sizeof(MeshInfoHeader));
+			handleMessage(message);
+			delete[] message.data;
+			continue;
+		}
 
-			if (!_scene->findNode(mainHeader->name))
-				createNode(meshInfo, msg + sizeof(MeshInfoHeader), mainHeader->name);
-			else
-				recreateMesh(meshInfo, msg + sizeof(MeshInfoHeader), mainHeader->name);
+		deferMessage(message);
+	}
 
-			break;
-		}
-		case MESH_UPDATE:
-		{
-			MeshInfoHeader meshInfo;
-			memcpy(&meshInfo, msg, sizeof(MeshInfoHeader));
+	Transform::resumeTransformChanged();
 
-			if (_scene->findNode(mainHeader->name))
-				updateMesh(msg + sizeof(MeshInfoHeader), meshInfo, mainHeader->name);
-			else
-				OutputDebugString(L"MESH_UPDATE | Could not find node...\n");
+	// Everything else in arrival order until the budget runs out, the rest waits for the next frame.
+	// At least one per frame, so a message larger than the byte budget still gets through
+	while (!deferredMessages.empty())
+	{
+		message = deferredMessages.front();
+		const size_t length = message.header.messageLength;
 
+		if (pumpStats.handled > 0 &&
+			(pumpStats.handledBytes + length > messageByteBudget || getAbsoluteTime() - start > messageTimeBudget))
 			break;
-		}
-		case TRANSFORM_DATA:
-		{
-			TransformDataHeader transHeader;
-			memcpy(&transHeader, msg, sizeof(TransformDataHeader));
 
-			if (_scene->findNode(mainHeader->name))
-				setTransform(*transHeader.transMtrx, mainHeader->name);
-			else
-				OutputDebugString(L"TRANSFORM_DATA | Could not find node...\n");
+		deferredMessages.pop_front();
+		deferredBytes -= length;
+		releasePendingNames(message);
 
-			break;
-		}
-		case MESH_MATERIAL:
-		{
-			MeshMaterialHeader header;
-			memcpy(&header, msg, sizeof(MeshMaterialHeader));
-			Node* pNode = _scene->findNode(mainHeader->name);
-			if (!pNode)
-				break;
+		handleMessage(message);
+		delete[] message.data;
 
-			Model* pModel = dynamic_cast<Model*>(pNode->getDrawable());
-			if (!pModel)
-				break;
+		pumpStats.handled++;
+		pumpStats.handledBytes += length;
+	}
 
-			attachMaterial(mainHeader->name, header.materialName);
+	pumpStats.milliseconds = (float)(getAbsoluteTime() - start);
+}
 
-			break;
-		}
-		case MATERIAL_DATA:
-		{
-			MaterialDataHeader matHeader;
-			memcpy(&matHeader, msg, sizeof(MaterialDataHeader));
+bool MayaViewer::isPriority(const ReceivedMessage& message) const
+{
+	const SectionHeader& header = message.header;
+	if (header.header != TRANSFORM_DATA && header.header != CAMERA_DATA)
+		return false;
 
-			setMaterial(matHeader, mainHeader->name);
+	// A deferred delete or rename of the node has to happen first
+	if (pendingNames.find(header.name.cStr) != pendingNames.end())
+		return false;
 
-			break;
-		}
-		case COLOR_TEXTURE:
-		{
-			TextureDataHeader matHeader;
-			memcpy(&matHeader, msg, sizeof(TextureDataHeader));
+	// Same for the parent, setParent would otherwise create a placeholder under a name the rename is about to take
+	if (header.header == TRANSFORM_DATA && !pendingNames.empty())
+	{
+		TransformDataHeader transform;
+		memcpy(&transform, message.data, sizeof(TransformDataHeader));
 
-			setMaterial(matHeader, mainHeader->name, true);
+		if (transform.parentName.cStr[0] && pendingNames.find(transform.parentName.cStr) != pendingNames.end())
+			return false;
+	}
 
-			break;
-		}
-		case NORMAL_TEXTURE:
-		{
-			TextureDataHeader matHeader;
-			memcpy(&matHeader, msg, sizeof(TextureDataHeader));
+	return true;
+}
+
+void MayaViewer::deferMessage(const ReceivedMessage& message)
+{
+	deferredMessages.push_back(message);
+	deferredBytes += message.header.messageLength;
 
-			setMaterial(matHeader, mainHeader->name, false);
+	if (message.header.header == NODE_DELETE)
+	{
+		pendingNames[message.header.name.cStr]++;
+	}
+	else if (message.header.header == NAME_CHANGE)
+	{
+		NameChangeHeader name;
+		memcpy(&name, message.data, sizeof(NameChangeHeader));
+
+		pendingNames[message.header.name.cStr]++;
+		pendingNames[name.newName.cStr]++;
+	}
+}
+
+void MayaViewer::releasePendingNames(const ReceivedMessage& message)
+{
+	auto release = [this](const char* name)
+	{
+		auto pending = pendingNames.find(name);
+		if (pending != pendingNames.end() && --pending->second == 0)
+			pendingNames.erase(pending);
+	};
+
+	if (message.header.header == NODE_DELETE)
+	{
+		release(message.header.name.cStr);
+	}
+	else if (message.header.header == NAME_CHANGE)
+	{
+		NameChangeHeader name;
+		memcpy(&name, message.data, sizeof(NameChangeHeader));
+
+		release(message.header.name.cStr);
+		release(name.newName.cStr);
+	}
+}
+
+void MayaViewer::handleMessage(ReceivedMessage& received)
+{
+	SectionHeader& header = received.header;
+	char* message = received.data;
+
+	switch (header.header)
+	{
+	default:
+		break;
+
+	case MESH_NEW:
+	case MESH_UPDATE:
+	{
+		receiveMesh(header.header, message, header.name);
+		setBoundingSphere(received.boundingSphere, header.name);
+		break;
+	}
+	case MESH_INSTANCE:
+	{
+		MeshInstanceHeader instance;
+		memcpy(&instance, message, sizeof(MeshInstanceHeader));
 
+		auto geometry = geometries.find(instance.geometryHash);
+		if (geometry == geometries.end())
+		{
+			OutputDebugString(L"MESH_INSTANCE | Could not find geometry...\n");
 			break;
 		}
-		case CAMERA_DATA:
-		{
-			CameraHeader camHeader;
-			memcpy(&camHeader, msg, sizeof(CameraHeader));
 
-			setCamera(camHeader, mainHeader->name);
+		Mesh* pMesh = geometry->second.pMesh;
+		acquireGeometry(header.name, instance.geometryHash, pMesh);
+		setMesh(pMesh, header.name);
+
+		break;
+	}
+	case TRANSFORM_DATA:
+	{
+		TransformDataHeader transHeader;
+		memcpy(&transHeader, message, sizeof(TransformDataHeader));
+
+		// Transforms without meshes (groups) still need a node for their children
+		Node* pNode = _scene->findNodeById(header.name);
+		if (!pNode)
+			pNode = _scene->addNode(header.name);
+
+		setParent(pNode, transHeader.parentName);
+		setTransform(*transHeader.transMtrx, header.name);
+
+		// Hold the edit like Maya does, the next TIME_SYNC resumes the clip
+		Animation* pAnimation = pNode->getAnimation(MAYA_CLIP_ID);
+		if (pAnimation)
+			pAnimation->getClip()->pause();
+
+		break;
+	}
+	case ANIMATION_CLIP:
+	{
+		AnimationClipHeader clipHeader;
+		memcpy(&clipHeader, message, sizeof(AnimationClipHeader));
+
+		setAnimationClip(clipHeader, (const TransformKey*)(message + sizeof(AnimationClipHeader)), header.name);
 
+		break;
+	}
+	case SKIN_DATA:
+	{
+		SkinDataHeader skinHeader;
+		memcpy(&skinHeader, message, sizeof(SkinDataHeader));
+
+		setSkin(skinHeader, (const float*)(message + sizeof(SkinDataHeader)), header.name);
+
+		break;
+	}
+	case JOINT_MATRICES:
+	{
+		JointMatricesHeader jointHeader;
+		memcpy(&jointHeader, message, sizeof(JointMatricesHeader));
+
+		setJointMatrices(jointHeader, (const float*)(message + sizeof(JointMatricesHeader)), header.name);
+
+		break;
+	}
+	case TIME_SYNC:
+	{
+		memcpy(&timeSync, message, sizeof(TimeSyncHeader));
+
+		_scene->visit(this, &MayaViewer::syncClip);
+
+		break;
+	}
+	case MESH_MATERIAL:
+	{
+		MeshMaterialHeader materialHeader;
+		memcpy(&materialHeader, message, sizeof(MeshMaterialHeader));
+		Node* pNode = _scene->findNodeById(header.name);
+		if (!pNode)
+			break;
+
+		Model* pModel = dynamic_cast<Model*>(pNode->getDrawable());
+		if (!pModel)
 			break;
+
+		attachMaterial(header.name, materialHeader.materialName);
+
+		break;
+	}
+	case MATERIAL_DELTA:
+	{
+		MaterialDeltaHeader delta;
+		memcpy(&delta, message, sizeof(MaterialDeltaHeader));
+
+		setMaterial(delta, header.name);
+
+		break;
+	}
+	case CAMERA_DATA:
+	{
+		CameraHeader camHeader;
+		memcpy(&camHeader, message, sizeof(CameraHeader));
+
+		setCamera(camHeader, header.name);
+
+		break;
+	}
+	case NODE_DELETE:
+	{
+		Node* pNode = _scene->findNodeById(header.name);
+		if (pNode)
+		{
+			// The children are removed along with the node, their own NODE_DELETEs won't find them anymore
+			releaseSubtree(pNode);
+
+			if (pNode->getParent())
+				pNode->getParent()->removeChild(pNode);
+			else
+				_scene->removeNode(pNode);
 		}
-		case NODE_DELETE:
+
+		break;
+	}
+	case NAME_CHANGE:
+	{
+		Node* pNode = _scene->findNodeById(header.name);
+		if (pNode)
 		{
-			Node* pNode = _scene->findNode(mainHeader->name);
-			if (pNode)
+			NameChangeHeader name;
+			memcpy(&name, message, sizeof(NameChangeHeader));
+
+			pNode->setId(name.newName);
+
+			auto geometry = nodeGeometry.find(header.name.cStr);
+			if (geometry != nodeGeometry.end())
 			{
-				pNode->setDrawable(nullptr);
-				pNode->setCamera(nullptr);
-				pNode->setLight(nullptr);
-				_scene->removeNode(pNode);
+				const uint64_t hash = geometry->second;
+				nodeGeometry.erase(geometry);
+				nodeGeometry[name.newName.cStr] = hash;
 			}
 
-			break;
-		}
-		case NAME_CHANGE:
-		{
-			Node* pNode = _scene->findNode(mainHeader->name);
-			if (pNode)
+			auto node = nodes.find(header.name.cStr);
+			if (node != nodes.end())
 			{
-				NameChangeHeader name;
-				memcpy(&name, msg, sizeof(NameChangeHeader));
+				const std::string materialName = node->second;
+				detachMaterial(header.name);
 
-				pNode->setId(name.newName);
+				nodes[name.newName.cStr] = materialName;
+				materialNodes[materialName].insert(name.newName.cStr);
 			}
-			break;
-		}
 		}
+		break;
+	}
+	}
+}
 
-		if (msg)
-		{
-			delete[] msg;
-			msg = nullptr;
-		}
+void MayaViewer::receiveMesh(Headers header, char* message, const char* nodeName)
+{
+	MeshInfoHeader meshInfo;
+	memcpy(&meshInfo, message, sizeof(MeshInfoHeader));
+
+	// Raw meshes were already expanded by the receive thread
+	char* pMeshData = message + sizeof(MeshInfoHeader);
+
+	if (header == MESH_NEW)
+	{
+		Mesh* pMesh = createGeometry(meshInfo, pMeshData, nodeName);
+		if (pMesh)
+			setMesh(pMesh, nodeName);
+
+		SAFE_RELEASE(pMesh);
+		return;
+	}
+
+	if (!_scene->findNodeById(nodeName))
+	{
+		OutputDebugString(L"receiveMesh | Could not find node...\n");
+		return;
 	}
+
+	// Other nodes still use the old geometry, give this node its own copy instead of writing into it
+	if (isGeometryShared(nodeName))
+	{
+		Mesh* pMesh = createGeometry(meshInfo, pMeshData, nodeName);
+		if (pMesh)
+			recreateMesh(pMesh, nodeName);
+
+		SAFE_RELEASE(pMesh);
+		return;
+	}
+
+	updateMesh(pMeshData, meshInfo, nodeName);
 }
 
 Camera* MayaViewer::createCamera(const CameraHeader& cameraHeader)
@@ -205,16 +444,121 @@ void MayaViewer::render(float elapsedTime)
 	// Clear the color and depth buffers
 	clear(CLEAR_COLOR_DEPTH, Vector4(0.1f, 0.0f, 0.0f, 1.0f), 1.0f, 0);
 
-	// Visit all the nodes in the scene for drawing
-	_scene->visit(this, &MayaViewer::drawScene);
+	// Queue the visible drawables, then draw them grouped by shader & texture, nearest first within a group
+	renderQueue.clear();
+	renderStats = RenderStats();
+
+	Camera* pCamera = _scene->getActiveCamera();
+	if (pCamera)
+	{
+		_scene->visit(this, &MayaViewer::queueDrawable);
+		std::sort(renderQueue.begin(), renderQueue.end());
+
+		for (const DrawItem& item : renderQueue)
+			item.pDrawable->draw(_wireframe);
+
+		renderStats.drawn = (unsigned int)renderQueue.size();
+	}
+
+	if (showStats)
+		drawStats();
 }
 
-bool MayaViewer::drawScene(Node* node)
+void MayaViewer::drawStats()
 {
-	// If the node visited contains a drawable object, draw it
-	Drawable* drawable = node->getDrawable();
-	if (drawable)
-		drawable->draw(_wireframe);
+	if (!statsFont)
+		return;
+
+	char text[512];
+	snprintf(text, sizeof(text),
+		"messages: %u received, %u handled (%.2f MB) in %.2f ms, %zu deferred (%.2f MB), budget %.1f ms / %.1f MB\n"
+		"receive thread: %zu decoded (%.2f MB), %zu dropped\n"
+		"draws: %u drawn, %u culled, %zu textures loading",
+		pumpStats.received, pumpStats.handled, pumpStats.handledBytes / (float)MB, pumpStats.milliseconds,
+		deferredMessages.size(), deferredBytes / (float)MB, messageTimeBudget, messageByteBudget / (float)MB,
+		receiver->queuedMessages(), receiver->queuedBytes() / (float)MB, receiver->droppedMessages(),
+		renderStats.drawn, renderStats.culled, textureLoader.loadingTextures());
+
+	statsFont->start();
+	statsFont->drawText(text, 5, 5, Vector4(1.f, 1.f, 1.f, 1.f), statsFont->getSize());
+	statsFont->finish();
+}
+
+bool MayaViewer::queueDrawable(Node* node)
+{
+	Drawable* pDrawable = node->getDrawable();
+	if (!pDrawable)
+		return true;
+
+	DrawItem item;
+	item.pDrawable = pDrawable;
+
+	Model* pModel = dynamic_cast<Model*>(pDrawable);
+	Mesh* pMesh = pModel ? pModel->getMesh() : nullptr;
+	if (pMesh)
+	{
+		// Only the node's own mesh, Node::getBoundingSphere also merges the children.
+		// Skinned meshes are always drawn, their bind pose bounds don't follow the joints
+		const BoundingSphere& local = pMesh->getBoundingSphere();
+		if (!local.isEmpty() && !pModel->getSkin())
+		{
+			BoundingSphere world(local);
+			world.transform(node->getWorldMatrix());
+
+			Camera* pCamera = _scene->getActiveCamera();
+			if (!world.intersects(pCamera->getFrustum()))
+			{
+				renderStats.culled++;
+				return true;
+			}
+
+			item.depth = world.center.distanceSquared(pCamera->getNode()->getTranslationWorld());
+		}
+
+		Material* pMaterial = pModel->getMaterial();
+		Technique* pTechnique = pMaterial ? pMaterial->getTechnique() : nullptr;
+		if (pTechnique && pTechnique->getPassCount() > 0)
+			item.effect = (uintptr_t)pTechnique->getPassByIndex(0)->getEffect();
+
+		// Shared per Maya shader, so the same texture is the same key
+		for (unsigned int i = 0, count = pMaterial ? pMaterial->getParameterCount() : 0; i < count; i++)
+		{
+			Texture::Sampler* pSampler = pMaterial->getParameterByIndex(i)->getSampler();
+			if (pSampler)
+			{
+				item.texture = (uintptr_t)pSampler->getTexture();
+				break;
+			}
+		}
+	}
+
+	renderQueue.push_back(item);
+	return true;
+}
+
+void MayaViewer::setBoundingSphere(const float* sphere, const char* nodeName)
+{
+	Node* pNode = _scene->findNodeById(nodeName);
+	Model* pModel = pNode ? dynamic_cast<Model*>(pNode->getDrawable()) : nullptr;
+	if (!pModel || !pModel->getMesh())
+		return;
+
+	pModel->getMesh()->setBoundingSphere(BoundingSphere(Vector3(sphere), sphere[3]));
+}
+
+bool MayaViewer::syncClip(Node* node)
+{
+	Animation* pAnimation = node->getAnimation(MAYA_CLIP_ID);
+	if (!pAnimation)
+		return true;
+
+	// Plays at real time between syncs, holds still while Maya is scrubbing or stopped
+	AnimationClip* pClip = pAnimation->getClip();
+	pClip->setSpeed(timeSync.playing ? 1.f : 0.f);
+	pClip->setElapsedTime(timeSync.time);
+
+	if (!pClip->isPlaying())
+		pClip->play();
 
 	return true;
 }
@@ -224,11 +568,11 @@ void MayaViewer::createTexturedMaterial(Model* pModel, bool hasNormal)
 	Material* pMat;
 	if (hasNormal)
 	{
-		pMat = pModel->setMaterial("res/shaders/normTex.vert", "res/shaders/normTex.frag", "POINT_LIGHT_COUNT 1");
+		pMat = pModel->setMaterial("res/shaders/normTex.vert", "res/shaders/normTex.frag", getShaderDefines(pModel).c_str());
 	}
 	else
 	{
-		pMat = pModel->setMaterial("res/shaders/textured.vert", "res/shaders/textured.frag", "POINT_LIGHT_COUNT 1");
+		pMat = pModel->setMaterial("res/shaders/textured.vert", "res/shaders/textured.frag", getShaderDefines(pModel).c_str());
 	}
 
 	pMat->setParameterAutoBinding("u_worldViewProjectionMatrix", "WORLD_VIEW_PROJECTION_MATRIX");
@@ -240,11 +584,16 @@ void MayaViewer::createTexturedMaterial(Model* pModel, bool hasNormal)
 	pMat->getStateBlock()->setCullFace(true);
 	pMat->getStateBlock()->setDepthTest(true);
 	pMat->getStateBlock()->setDepthWrite(true);
+
+	if (pModel->getSkin())
+		pMat->setParameterAutoBinding("u_matrixPalette", "MATRIX_PALETTE");
+
+	setVertexBounds(pModel);
 }
 
 void MayaViewer::createColoredMaterial(Model* pModel)
 {
-	Material* pMat = pModel->setMaterial("res/shaders/colored.vert", "res/shaders/colored.frag", "POINT_LIGHT_COUNT 1");
+	Material* pMat = pModel->setMaterial("res/shaders/colored.vert", "res/shaders/colored.frag", getShaderDefines(pModel).c_str());
 	pMat->setParameterAutoBinding("u_worldViewProjectionMatrix", "WORLD_VIEW_PROJECTION_MATRIX");
 	pMat->setParameterAutoBinding("u_inverseTransposeWorldViewMatrix", "INVERSE_TRANSPOSE_WORLD_VIEW_MATRIX");
 	pMat->getParameter("u_ambientColor")->setValue(Vector3(0.1f, 0.1f, 0.1f));
@@ -255,22 +604,39 @@ void MayaViewer::createColoredMaterial(Model* pModel)
 	pMat->getStateBlock()->setCullFace(true);
 	pMat->getStateBlock()->setDepthTest(true);
 	pMat->getStateBlock()->setDepthWrite(true);
+
+	if (pModel->getSkin())
+		pMat->setParameterAutoBinding("u_matrixPalette", "MATRIX_PALETTE");
+
+	setVertexBounds(pModel);
 }
 
-void MayaViewer::createNode(const MeshInfoHeader& header, void* pMeshData, const char* nodeName)
+void MayaViewer::resetMaterial(Model* pModel, const char* nodeName)
 {
-	Mesh* pMesh = createMesh(header, pMeshData);
-	if (!pMesh)
-	{
-		OutputDebugString(L"createNode | Failed to create mesh...\n");
-		return;
-	}
+	auto node = nodes.find(nodeName);
+	if (node != nodes.end() && materials.find(node->second) != materials.end())
+		attachMaterial(nodeName, node->second.c_str());
+	else
+		createColoredMaterial(pModel);
+}
+
+void MayaViewer::setMesh(Mesh* pMesh, const char* nodeName)
+{
+	// The node can already exist without a model if its transform arrived first
+	Node* pNode = _scene->findNodeById(nodeName);
+	if (!pNode || !pNode->getDrawable())
+		createNode(pMesh, nodeName);
+	else
+		recreateMesh(pMesh, nodeName);
+}
 
-	Node* pNode = _scene->addNode(mainHeader->name.cStr);
+void MayaViewer::createNode(Mesh* pMesh, const char* nodeName)
+{
+	Node* pNode = _scene->findNodeById(nodeName);
+	if (!pNode)
+		pNode = _scene->addNode(nodeName);
 
 	Model* pModel = Model::create(pMesh);
-	SAFE_RELEASE(pMesh);
-
 	if (!pModel)
 	{
 		OutputDebugString(L"createNode | Failed to create model...\n");
@@ -283,22 +649,15 @@ void MayaViewer::createNode(const MeshInfoHeader& header, void* pMeshData, const
 	SAFE_RELEASE(pModel);
 }
 
-void MayaViewer::recreateMesh(const MeshInfoHeader& header, void* pMeshData, const char* nodeName)
+void MayaViewer::recreateMesh(Mesh* pMesh, const char* nodeName)
 {
-	Node* pNode = _scene->findNode(nodeName);
+	Node* pNode = _scene->findNodeById(nodeName);
 	if (!pNode)
 	{
 		OutputDebugString(L"recreateMesh | Couldn't find node...\n");
 		return;
 	}
 
-	Mesh* pMesh = createMesh(header, pMeshData);
-	if (!pMesh)
-	{
-		OutputDebugString(L"recreateMesh | Failed to create new mesh...\n");
-		return;
-	}
-
 	Model* pOldModel = dynamic_cast<Model*>(pNode->getDrawable());
 	if (!pOldModel)
 	{
@@ -320,16 +679,27 @@ void MayaViewer::recreateMesh(const MeshInfoHeader& header, void* pMeshData, con
 		return;
 	}
 
-	pModel->setMaterial(pMaterial);
+	// The old material only fits if the shader variant is the same. Moved over before setDrawable, which releases
+	// the old model & with it the material
+	const bool sameVariant = getShaderDefines(pOldModel) == getShaderDefines(pModel);
+	if (sameVariant)
+	{
+		pModel->setMaterial(pMaterial);
+		setVertexBounds(pModel);
+	}
+
 	pNode->setDrawable(pModel);
 
-	SAFE_RELEASE(pMesh);
+	// attachMaterial looks the model up through the node
+	if (!sameVariant)
+		resetMaterial(pModel, nodeName);
+
 	SAFE_RELEASE(pModel);
 }
 
 void MayaViewer::updateMesh(char* meshData, const MeshInfoHeader& meshInfo, const char* nodeName)
 {
-	Node* pNode = _scene->findNode(nodeName);
+	Node* pNode = _scene->findNodeById(nodeName);
 	if (!pNode)
 	{
 		OutputDebugString(L"updateMesh | Couldn't find node...\n");
@@ -350,54 +720,160 @@ void MayaViewer::updateMesh(char* meshData, const MeshInfoHeader& meshInfo, cons
 		return;
 	}
 	
-	const size_t vertexBytes = meshInfo.numVertex * sizeof(Vertex);
+	const size_t stride = vertexSize(meshInfo.layout);
+	MeshPart* pPart = pMesh->getPart(0);
 
-	void* pOldVertexData = pMesh->mapVertexBuffer();
-	memcpy(pOldVertexData, meshData, vertexBytes);
-	pMesh->unmapVertexBuffer();
-	
-	void* pOldIndexData = pMesh->getPart(0)->mapIndexBuffer();
-	memcpy(pOldIndexData, meshData + vertexBytes, meshInfo.numIndex * sizeof(int));
-	pMesh->getPart(0)->unmapIndexBuffer();
+	// Different topology or layout doesn't fit the buffers, start over with a new mesh
+	if (pMesh->getVertexCount() != meshInfo.numVertex || pMesh->getVertexSize() != stride ||
+		!pPart || pPart->getIndexCount() != meshInfo.numIndex)
+	{
+		Mesh* pNewMesh = createGeometry(meshInfo, meshData, nodeName);
+		if (pNewMesh)
+			recreateMesh(pNewMesh, nodeName);
+
+		SAFE_RELEASE(pNewMesh);
+		return;
+	}
+
+	const size_t vertexBytes = meshInfo.numVertex * stride;
+	const size_t indexBytes = meshInfo.numIndex * sizeof(int);
+
+	// Taken from the geometry entry, which is replaced once the new hash is acquired
+	std::vector<char> shadow;
+	auto geometry = nodeGeometry.find(nodeName);
+	if (geometry != nodeGeometry.end())
+	{
+		auto current = geometries.find(geometry->second);
+		if (current != geometries.end() && current->second.pMesh == pMesh)
+			shadow = std::move(current->second.shadow);
+	}
+
+	if (shadow.size() != vertexBytes + indexBytes)
+	{
+		// First edit, nothing to diff against. Respecifying the whole buffers lets the driver orphan the old storage
+		pMesh->setVertexData(meshData);
+		pPart->setIndexData(meshData + vertexBytes, 0, 0);
+		shadow.assign(meshData, meshData + vertexBytes + indexBytes);
+	}
+	else
+	{
+		uploadChanges(pMesh, pPart, shadow.data(), meshData, meshInfo);
+		memcpy(shadow.data(), meshData, vertexBytes + indexBytes);
+	}
+
+	pMesh->setBoundingBox(BoundingBox(Vector3(meshInfo.boundsMin), Vector3(meshInfo.boundsMax)));
+	setVertexBounds(pModel);
+
+	// Same mesh, but it now holds different geometry
+	acquireGeometry(nodeName, meshInfo.geometryHash, pMesh);
+
+	Geometry& updated = geometries[meshInfo.geometryHash];
+	if (updated.pMesh == pMesh)
+		updated.shadow = std::move(shadow);
+}
+
+// Starts & counts of the blocks of blockSize elements that differ between pOld & pNew, neighbouring blocks merged
+static unsigned int findDirtyRanges(const char* pOld, const char* pNew, unsigned int count, size_t elementSize,
+	unsigned int blockSize, std::vector<unsigned int>& ranges)
+{
+	ranges.clear();
+	unsigned int dirty = 0;
+
+	for (unsigned int start = 0; start < count; start += blockSize)
+	{
+		const unsigned int length = std::min(blockSize, count - start);
+		if (memcmp(pOld + start * elementSize, pNew + start * elementSize, length * elementSize) == 0)
+			continue;
+
+		if (!ranges.empty() && ranges[ranges.size() - 2] + ranges.back() == start)
+		{
+			ranges.back() += length;
+		}
+		else
+		{
+			ranges.push_back(start);
+			ranges.push_back(length);
+		}
+		dirty += length;
+	}
+
+	return dirty;
+}
+
+void MayaViewer::uploadChanges(Mesh* pMesh, MeshPart* pPart, const char* pOld, const char* pNew, const MeshInfoHeader& meshInfo)
+{
+	const size_t stride = vertexSize(meshInfo.layout);
+	const size_t vertexBytes = meshInfo.numVertex * stride;
+
+	std::vector<unsigned int> ranges;
+
+	// Mostly rewritten, a whole (orphaning) upload beats many small ones
+	const unsigned int dirtyVertices = findDirtyRanges(pOld, pNew, meshInfo.numVertex, stride, DIRTY_BLOCK_SIZE, ranges);
+	if (dirtyVertices > meshInfo.numVertex * MAX_DIRTY_FRACTION)
+		pMesh->setVertexData(pNew);
+	else if (dirtyVertices > 0)
+		pMesh->setVertexDataRanges(pNew, ranges.data(), (unsigned int)ranges.size() / 2);
+
+	const unsigned int dirtyIndices = findDirtyRanges(pOld + vertexBytes, pNew + vertexBytes, meshInfo.numIndex, sizeof(int), DIRTY_BLOCK_SIZE, ranges);
+	if (dirtyIndices > meshInfo.numIndex * MAX_DIRTY_FRACTION)
+		pPart->setIndexData(pNew + vertexBytes, 0, 0);
+	else if (dirtyIndices > 0)
+		pPart->setIndexDataRanges(pNew + vertexBytes, ranges.data(), (unsigned int)ranges.size() / 2);
 }
 
 void MayaViewer::setTransform(const float* matrix, const char* nodeName)
 {
-	Node* pNode = _scene->findNode(mainHeader->name);
+	Node* pNode = _scene->findNodeById(nodeName);
 	if (!pNode)
 	{
 		OutputDebugString(L"setTransform | Could not find node...\n");
 		return;
 	}
 
-	Matrix mtrx = Matrix(matrix);
-	Vector3* translate = new Vector3;
-	Vector3* scale = new Vector3;
-	Quaternion* rotation = new Quaternion;
-	mtrx.decompose(scale, rotation, translate);
+	pNode->set(Matrix(matrix));
+}
+
+void MayaViewer::setParent(Node* pNode, const char* parentName)
+{
+	Node* pParent = nullptr;
+	if (parentName[0] != '\0')
+	{
+		pParent = _scene->findNodeById(parentName);
+		if (!pParent)
+			pParent = _scene->addNode(parentName);
+	}
+
+	if (pNode->getParent() == pParent)
+		return;
 
-	Matrix* rotMtrx = new Matrix;
-	Matrix::createRotation(*rotation, rotMtrx);
+	if (!pParent)
+	{
+		_scene->addNode(pNode);
+		return;
+	}
 
-	pNode->setTranslation(*translate);
-	pNode->setScale(*scale);
-	pNode->setRotation(*rotMtrx);
+	// Messages can arrive out of order while reparenting, never create a cycle
+	for (Node* pAncestor = pParent; pAncestor; pAncestor = pAncestor->getParent())
+	{
+		if (pAncestor == pNode)
+		{
+			OutputDebugString(L"setParent | Parent is a descendant of the node...\n");
+			return;
+		}
+	}
 
-	delete translate;
-	delete scale;
-	delete rotation;
-	delete rotMtrx;
+	pParent->addChild(pNode);
 }
 
 void MayaViewer::setCamera(const CameraHeader& camHeader, const char* nodeName)
 {
 	const float AspectRatio = camHeader.width / camHeader.height;
 
-	Node* pNode = _scene->findNode(mainHeader->name);
+	Node* pNode = _scene->findNodeById(nodeName);
 	if (!pNode)
-		pNode = _scene->addNode(mainHeader->name);
+		pNode = _scene->addNode(nodeName);
 
-	setTransform(*camHeader.viewMatrix, mainHeader->name);
+	setTransform(*camHeader.viewMatrix, nodeName);
 
 	Camera* pCamera = pNode->getCamera();
 	if (!pCamera)
@@ -424,6 +900,109 @@ void MayaViewer::setCamera(const CameraHeader& camHeader, const char* nodeName)
 		_scene->setActiveCamera(pNode->getCamera());
 }
 
+void MayaViewer::setAnimationClip(const AnimationClipHeader& header, const TransformKey* pKeys, const char* nodeName)
+{
+	Node* pNode = _scene->findNodeById(nodeName);
+	if (!pNode)
+		pNode = _scene->addNode(nodeName);
+
+	pNode->destroyAnimation(MAYA_CLIP_ID);
+
+	if (header.numKeys == 0)
+		return;
+
+	/*
+		Looping clips wrap at their duration, so the last key would show the first one.
+		Holding the last key for an extra millisecond keeps the final frame reachable.
+	*/
+	const unsigned int numKeys = header.numKeys + 1;
+
+	std::vector<unsigned int> keyTimes(numKeys);
+	std::vector<float> keyValues(numKeys * 10);
+
+	for (unsigned int i = 0; i < numKeys; i++)
+	{
+		const TransformKey& key = pKeys[i < header.numKeys ? i : header.numKeys - 1];
+
+		keyTimes[i] = i < header.numKeys ? key.time : key.time + 1;
+
+		float* pValues = &keyValues[i * 10];
+		memcpy(pValues, key.scale, sizeof(float) * 3);
+		memcpy(pValues + 3, key.rotation, sizeof(float) * 4);
+		memcpy(pValues + 7, key.translation, sizeof(float) * 3);
+	}
+
+	Animation* pAnimation = pNode->createAnimation(MAYA_CLIP_ID, Transform::ANIMATE_SCALE_ROTATE_TRANSLATE,
+		numKeys, keyTimes.data(), keyValues.data(), Curve::LINEAR);
+	if (!pAnimation)
+	{
+		OutputDebugString(L"setAnimationClip | Failed to create animation...\n");
+		return;
+	}
+
+	AnimationClip* pClip = pAnimation->getClip();
+	pClip->setRepeatCount(AnimationClip::REPEAT_INDEFINITE);
+
+	// The node's channel keeps the animation alive
+	SAFE_RELEASE(pAnimation);
+
+	syncClip(pNode);
+}
+
+void MayaViewer::setSkin(const SkinDataHeader& header, const float* pInverseBinds, const char* nodeName)
+{
+	Node* pNode = _scene->findNodeById(nodeName);
+	if (!pNode)
+	{
+		OutputDebugString(L"setSkin | Couldn't find node...\n");
+		return;
+	}
+
+	Model* pModel = dynamic_cast<Model*>(pNode->getDrawable());
+	if (!pModel || header.numJoints == 0)
+	{
+		OutputDebugString(L"setSkin | Couldn't get model...\n");
+		return;
+	}
+
+	// Joints live outside the scene, JOINT_MATRICES sets them to the Maya joints' world matrices
+	MeshSkin* pSkin = MeshSkin::create(header.numJoints);
+	pSkin->setBindShape(*header.bindShape);
+
+	for (unsigned int i = 0; i < header.numJoints; i++)
+	{
+		Joint* pJoint = Joint::create(std::to_string(i).c_str());
+		pJoint->setInverseBindPose(Matrix(pInverseBinds + i * 16));
+		pSkin->setJoint(pJoint, i);
+		SAFE_RELEASE(pJoint);
+	}
+
+	pSkin->setRootJoint(pSkin->getJoint(0u));
+	pModel->setSkin(pSkin);
+
+	resetMaterial(pModel, nodeName);
+}
+
+void MayaViewer::setJointMatrices(const JointMatricesHeader& header, const float* pMatrices, const char* nodeName)
+{
+	Node* pNode = _scene->findNodeById(nodeName);
+	if (!pNode)
+		return;
+
+	Model* pModel = dynamic_cast<Model*>(pNode->getDrawable());
+	MeshSkin* pSkin = pModel ? pModel->getSkin() : nullptr;
+	if (!pSkin)
+	{
+		OutputDebugString(L"setJointMatrices | Node has no skin...\n");
+		return;
+	}
+
+	const unsigned int numJoints = std::min(header.numJoints, pSkin->getJointCount());
+
+	for (unsigned int i = 0; i < numJoints; i++)
+		pSkin->getJoint(i)->set(Matrix(pMatrices + i * 16));
+}
+
 void MayaViewer::keyEvent(Keyboard::KeyEvent evt, int key)
 {
 	if (key >= 256)
@@ -437,6 +1016,9 @@ void MayaViewer::keyEvent(Keyboard::KeyEvent evt, int key)
 		case Keyboard::KEY_ESCAPE:
 			exit();
 			break;
+		case Keyboard::KEY_F3:
+			showStats = !showStats;
+			break;
 		};
 	}
 	else if (evt == Keyboard::KEY_RELEASE)
@@ -480,7 +1062,7 @@ void MayaViewer::attachMaterial(const char* nodeName, const char* materialName)
 	if (mat == materials.end())
 		return;
 
-	Node* pNode = _scene->findNode(nodeName);
+	Node* pNode = _scene->findNodeById(nodeName);
 	if (!pNode)
 		return;
 
@@ -488,121 +1070,133 @@ void MayaViewer::attachMaterial(const char* nodeName, const char* materialName)
 	if (!pModel)
 		return;
 
+	// Each node still needs its own Material, passes hold the vertex binding of one mesh and auto bindings one node.
+	// The shader's parameters are shared between them though, see Mat
+	Mat& shader = mat->second;
 
 	// Materials with no diffuse but normal map, will be seen as colored, and wont try applying the normal map
-	if (mat->second.colored)
+	if (shader.colored)
 	{
 		createColoredMaterial(pModel);
-		pModel->getMaterial()->getParameter("u_diffuseColor")->setValue(mat->second.color);
+		if (shareParameter(pModel->getMaterial(), "u_diffuseColor", shader.pColor))
+			shader.pColor->setValue(shader.color);
 
 #if weHadColoredNormalMapShader
-		Texture::Sampler* pSampler = pModel->getMaterial()->getParameter("u_normalmapTexture")->setValue(mat->second.normal.c_str(), true);
+		Texture::Sampler* pSampler = pModel->getMaterial()->getParameter("u_normalmapTexture")->setValue(shader.normal.c_str(), true);
 		pSampler->setFilterMode(Texture::LINEAR_MIPMAP_LINEAR, Texture::LINEAR);
 #endif
 
 	}
 	else
 	{
-		bool hasNormal = mat->second.normal != "";
+		bool hasNormal = shader.normal != "";
 		createTexturedMaterial(pModel, hasNormal);
 
-		if (mat->second.diffuse != "")
-		{
-			Texture::Sampler* pSampler = pModel->getMaterial()->getParameter("u_diffuseTexture")->setValue(mat->second.diffuse.c_str(), true);
-			pSampler->setFilterMode(Texture::LINEAR_MIPMAP_LINEAR, Texture::LINEAR);
-		}
-		if (mat->second.normal != "")
-		{
-			Texture::Sampler* pSampler = pModel->getMaterial()->getParameter("u_normalmapTexture")->setValue(mat->second.normal.c_str(), true);
-			pSampler->setFilterMode(Texture::LINEAR_MIPMAP_LINEAR, Texture::LINEAR);
-		}
+		if (shader.diffuse != "" && shareParameter(pModel->getMaterial(), "u_diffuseTexture", shader.pDiffuse))
+			textureLoader.bind(shader.pDiffuse, shader.diffuse.c_str(), false);
+		if (hasNormal && shareParameter(pModel->getMaterial(), "u_normalmapTexture", shader.pNormal))
+			textureLoader.bind(shader.pNormal, shader.normal.c_str(), true);
 	}
 
+	auto node = nodes.find(nodeName);
+	if (node != nodes.end() && node->second != materialName)
+		detachMaterial(nodeName);
 
 	nodes[nodeName] = materialName;
+	materialNodes[materialName].insert(nodeName);
 }
 
-void MayaViewer::setMaterial(const MaterialDataHeader& header, const char* materialName)
+void MayaViewer::detachMaterial(const char* nodeName)
 {
-	Vector4 color = header.color;
-
-	bool found = false;
+	auto node = nodes.find(nodeName);
+	if (node == nodes.end())
+		return;
 
-	for (auto& material : materials)
+	auto users = materialNodes.find(node->second);
+	if (users != materialNodes.end())
 	{
-		if (material.first == materialName)
-			found = true;
+		users->second.erase(nodeName);
+		if (users->second.empty())
+			materialNodes.erase(users);
 	}
 
-	materials[materialName].color = color;
-	materials[materialName].colored = true;
-	
-	for (auto& node : nodes)
-	{
-		if (node.second == materialName)
-		{
-			Node* pNode = _scene->findNode(node.first.c_str());
-			if (!pNode)
-				continue;
-
-			Model* pModel = dynamic_cast<Model*>(pNode->getDrawable());
-			if (!pModel)
-				continue;
-
-			createColoredMaterial(pModel);
+	nodes.erase(node);
+}
 
-			pModel->getMaterial()->getParameter("u_diffuseColor")->setValue(color);
-		}
+bool MayaViewer::shareParameter(Material* pMaterial, const char* name, MaterialParameter*& pShared)
+{
+	if (pShared)
+	{
+		pMaterial->removeParameter(name);
+		pMaterial->addParameter(pShared);
+		return false;
 	}
 
+	pShared = pMaterial->getParameter(name);
+	pShared->addRef();
+	return true;
 }
 
-void MayaViewer::setMaterial(const TextureDataHeader& header, const char* materialName, bool diffuse)
+void MayaViewer::releaseSharedParameters(Mat& mat)
 {
-	bool found = false;
-	if (materials.find(materialName) == materials.end())
-	{
-		materials[materialName].colored = false;
-	}
+	SAFE_RELEASE(mat.pColor);
+	SAFE_RELEASE(mat.pDiffuse);
+	SAFE_RELEASE(mat.pNormal);
+}
 
-	if (diffuse)
-		materials[materialName].diffuse = header.path.cStr;
-	else
-		materials[materialName].normal = header.path.cStr;
+void MayaViewer::setMaterial(const MaterialDeltaHeader& delta, const char* materialName)
+{
+	const bool known = materials.find(materialName) != materials.end();
+	Mat& mat = materials[materialName];
 
+	const bool wasColored = mat.colored;
+	const bool hadNormal = mat.normal != "";
+
+	if (delta.changed & MATERIAL_COLOR)
+		mat.color = Vector4(delta.color);
+	if (delta.changed & MATERIAL_DIFFUSE)
+		mat.diffuse = delta.diffuse.cStr;
+	if (delta.changed & MATERIAL_NORMAL)
+		mat.normal = delta.normal.cStr;
 
 	// Materials with no diffuse but normal map will be seen as colored, and not try to apply the textures
-	auto& mat = materials.find(materialName);
-	for (auto& node : nodes)
+	mat.colored = mat.diffuse == "";
+
+	// The shader only changes when switching between colored, textured & normal mapped, anything else is patched in place
+	const bool rebuild = !known || mat.colored != wasColored || (!mat.colored && (mat.normal != "") != hadNormal);
+	if (!rebuild)
 	{
-		if (node.second == materialName)
-		{
-			Node* pNode = _scene->findNode(node.first.c_str());
-			if (!pNode)
-				continue;
+		patchMaterial(mat, delta.changed);
+		return;
+	}
 
-			Model* pModel = dynamic_cast<Model*>(pNode->getDrawable());
-			if (!pModel)
-				continue;
+	// The first node attached creates new shared parameters for the new shader
+	releaseSharedParameters(mat);
 
-			bool hasNormal = mat->second.normal != "";
-			createTexturedMaterial(pModel, hasNormal);
+	auto users = materialNodes.find(materialName);
+	if (users == materialNodes.end())
+		return;
 
-			if (mat->second.diffuse != "")
-			{
-				Texture::Sampler* pSampler = pModel->getMaterial()->getParameter("u_diffuseTexture")->setValue(mat->second.diffuse.c_str(), true);
-				pSampler->setFilterMode(Texture::LINEAR_MIPMAP_LINEAR, Texture::LINEAR);
-			}
+	const std::vector<std::string> nodeNames(users->second.begin(), users->second.end());
+	for (const std::string& nodeName : nodeNames)
+		attachMaterial(nodeName.c_str(), materialName);
+}
 
-			if (mat->second.normal != "")
-			{
-				Texture::Sampler* pSampler = pModel->getMaterial()->getParameter("u_normalmapTexture")->setValue(mat->second.normal.c_str(), true);
-				pSampler->setFilterMode(Texture::LINEAR_MIPMAP_LINEAR, Texture::LINEAR);
-			}
-		}
+void MayaViewer::patchMaterial(Mat& mat, unsigned int changed)
+{
+	if (mat.colored)
+	{
+		if ((changed & MATERIAL_COLOR) && mat.pColor)
+			mat.pColor->setValue(mat.color);
+
+		return;
 	}
 
-	materials[materialName].colored = false;
+	if ((changed & MATERIAL_DIFFUSE) && mat.pDiffuse)
+		textureLoader.bind(mat.pDiffuse, mat.diffuse.c_str(), false);
+
+	if ((changed & MATERIAL_NORMAL) && mat.normal != "" && mat.pNormal)
+		textureLoader.bind(mat.pNormal, mat.normal.c_str(), true);
 }
 
 Mesh* MayaViewer::createMesh(const MeshInfoHeader& info, void* data)
@@ -616,7 +1210,33 @@ Mesh* MayaViewer::createMesh(const MeshInfoHeader& info, void* data)
 		VertexFormat::Element(VertexFormat::BINORMAL, 3),
 	};
 
-	Mesh* mesh = Mesh::createMesh(VertexFormat(elements, 5), info.numVertex, true);
+	// Matches SkinnedVertex, used by the SKINNING shader variant
+	VertexFormat::Element skinnedElements[] =
+	{
+		VertexFormat::Element(VertexFormat::POSITION, 3),
+		VertexFormat::Element(VertexFormat::TEXCOORD0, 2),
+		VertexFormat::Element(VertexFormat::NORMAL, 3),
+		VertexFormat::Element(VertexFormat::TANGENT, 3),
+		VertexFormat::Element(VertexFormat::BINORMAL, 3),
+		VertexFormat::Element(VertexFormat::BLENDWEIGHTS, 4),
+		VertexFormat::Element(VertexFormat::BLENDINDICES, 4),
+	};
+
+	// Matches PackedVertex, decoded by the PACKED_VERTEX shader variant
+	VertexFormat::Element packedElements[] =
+	{
+		VertexFormat::Element(VertexFormat::POSITION, 4, VertexFormat::UNSIGNED_SHORT, true),
+		VertexFormat::Element(VertexFormat::TEXCOORD0, 2, VertexFormat::HALF_FLOAT),
+		VertexFormat::Element(VertexFormat::NORMAL, 2, VertexFormat::SHORT, true),
+		VertexFormat::Element(VertexFormat::TANGENT, 2, VertexFormat::SHORT, true),
+	};
+
+	const VertexFormat format =
+		info.layout == VERTEX_PACKED ? VertexFormat(packedElements, 4) :
+		info.layout == VERTEX_SKINNED ? VertexFormat(skinnedElements, 7) :
+		VertexFormat(elements, 5);
+
+	Mesh* mesh = Mesh::createMesh(format, info.numVertex, true);
 	if (mesh == NULL)
 	{
 		GP_ERROR("createMesh | Failed to create mesh.");
@@ -625,6 +1245,106 @@ Mesh* MayaViewer::createMesh(const MeshInfoHeader& info, void* data)
 
 	mesh->setVertexData(data, 0, info.numVertex);
 	MeshPart* meshPart = mesh->addPart(Mesh::TRIANGLES, Mesh::IndexFormat::INDEX32, info.numIndex, true);
-	meshPart->setIndexData((char*)data + sizeof(Vertex) * info.numVertex, 0, info.numIndex);
+	meshPart->setIndexData((char*)data + vertexSize(info.layout) * info.numVertex, 0, info.numIndex);
+
+	mesh->setBoundingBox(BoundingBox(Vector3(info.boundsMin), Vector3(info.boundsMax)));
 	return mesh;
+}
+
+Mesh* MayaViewer::createGeometry(const MeshInfoHeader& info, void* data, const char* nodeName)
+{
+	Mesh* pMesh = createMesh(info, data);
+	if (!pMesh)
+	{
+		OutputDebugString(L"createGeometry | Failed to create mesh...\n");
+		return nullptr;
+	}
+
+	acquireGeometry(nodeName, info.geometryHash, pMesh);
+	return pMesh;
+}
+
+void MayaViewer::acquireGeometry(const char* nodeName, uint64_t hash, Mesh* pMesh)
+{
+	// Identical geometry from another node keeps its mesh, later instances reference that one
+	Geometry& geometry = geometries[hash];
+	if (!geometry.pMesh)
+	{
+		geometry.pMesh = pMesh;
+		pMesh->addRef();
+	}
+	geometry.users++;
+
+	// Added before releasing so re-acquiring the same hash never drops the mesh
+	releaseGeometry(nodeName);
+	nodeGeometry[nodeName] = hash;
+}
+
+void MayaViewer::releaseGeometry(const char* nodeName)
+{
+	auto node = nodeGeometry.find(nodeName);
+	if (node == nodeGeometry.end())
+		return;
+
+	auto geometry = geometries.find(node->second);
+	if (geometry != geometries.end() && --geometry->second.users == 0)
+	{
+		SAFE_RELEASE(geometry->second.pMesh);
+		geometries.erase(geometry);
+	}
+
+	nodeGeometry.erase(node);
+}
+
+void MayaViewer::releaseSubtree(Node* pNode)
+{
+	for (Node* pChild = pNode->getFirstChild(); pChild; pChild = pChild->getNextSibling())
+		releaseSubtree(pChild);
+
+	pNode->setDrawable(nullptr);
+	pNode->setCamera(nullptr);
+	pNode->setLight(nullptr);
+	releaseGeometry(pNode->getId());
+	detachMaterial(pNode->getId());
+}
+
+bool MayaViewer::isGeometryShared(const char* nodeName)
+{
+	auto node = nodeGeometry.find(nodeName);
+	if (node == nodeGeometry.end())
+		return false;
+
+	auto geometry = geometries.find(node->second);
+	return geometry != geometries.end() && geometry->second.users > 1;
+}
+
+bool MayaViewer::isPacked(Model* pModel)
+{
+	Mesh* pMesh = pModel->getMesh();
+	return pMesh && pMesh->getVertexFormat().getElement(0).type != VertexFormat::FLOAT;
+}
+
+std::string MayaViewer::getShaderDefines(Model* pModel)
+{
+	std::string defines = "POINT_LIGHT_COUNT 1";
+
+	if (isPacked(pModel))
+		defines += ";PACKED_VERTEX";
+
+	MeshSkin* pSkin = pModel->getSkin();
+	if (pSkin)
+		defines += ";SKINNING;SKINNING_JOINT_COUNT " + std::to_string(pSkin->getJointCount());
+
+	return defines;
+}
+
+void MayaViewer::setVertexBounds(Model* pModel)
+{
+	Material* pMat = pModel->getMaterial();
+	if (!pMat || !isPacked(pModel))
+		return;
+
+	const BoundingBox& bounds = pModel->getMesh()->getBoundingBox();
+	pMat->getParameter("u_positionOffset")->setValue(bounds.min);
+	pMat->getParameter("u_positionScale")->setValue(bounds.max - bounds.min);
 }
\ No newline at end of file
@@ -2,7 +2,10 @@
 #define MayaViewer_H_
 
 #include "gameplay.h"
-#include "../../Memory/Comlib.h"
+#include "MessageReceiver.h"
+#include "TextureLoader.h"
+#include <deque>
+#include <unordered_set>
 
 using namespace gameplay;
 
@@ -36,6 +39,13 @@ public:
 	// mouse events
 	bool mouseEvent(Mouse::MouseEvent evt, int x, int y, int wheelDelta);
 
+    /**
+     * Sets how long update may spend on received messages each frame, and how many payload bytes it may handle.
+     *
+     * Transforms and cameras don't count against the budget, other messages left over wait for the next frames.
+     */
+    void setMessageBudget(float milliseconds, size_t bytes);
+
 
 protected:
 
@@ -66,8 +76,64 @@ private:
 
     // Message handling
     Comlib* consumerBuffer;
-    char* msg;
-    SectionHeader* mainHeader;
+    MessageReceiver* receiver;
+
+    // Stop taking from the receiver once this much waits in deferredMessages
+    static const size_t MAX_DEFERRED_BYTES = 256 * MB;
+
+    struct PumpStats
+    {
+        unsigned int received = 0;
+        unsigned int handled = 0;
+        size_t handledBytes = 0;
+        float milliseconds = 0.f;
+    };
+
+    // Per frame, see setMessageBudget
+    float messageTimeBudget = 8.f;
+    size_t messageByteBudget = 32 * MB;
+
+    std::deque<ReceivedMessage> deferredMessages;
+    size_t deferredBytes = 0;
+
+    // nodeName - deferred NODE_DELETE & NAME_CHANGE (old & new name) messages, transforms for these wait in line
+    std::unordered_map<std::string, unsigned int> pendingNames;
+
+    // Material textures, decoded in the background behind placeholders
+    TextureLoader textureLoader;
+
+    // Drawn in order after sorting: shader variant, then texture, then front to back
+    struct DrawItem
+    {
+        Drawable* pDrawable = nullptr;
+        uintptr_t effect = 0;
+        uintptr_t texture = 0;
+        float depth = 0.f;
+
+        bool operator<(const DrawItem& other) const
+        {
+            if (effect != other.effect)
+                return effect < other.effect;
+            if (texture != other.texture)
+                return texture < other.texture;
+            return depth < other.depth;
+        }
+    };
+
+    struct RenderStats
+    {
+        unsigned int drawn = 0;
+        unsigned int culled = 0;
+    };
+
+    // Rebuilt every frame, keeps its capacity
+    std::vector<DrawItem> renderQueue;
+    RenderStats renderStats;
+
+    // Last frame's, shown on the overlay (F3)
+    PumpStats pumpStats;
+    Font* statsFont;
+    bool showStats;
 
     struct Mat
     {
@@ -75,35 +141,121 @@ private:
         Vector4 color;
         std::string diffuse;
         std::string normal;
+
+        // Shared by the Materials of every node using this shader, so an edit is a single setValue.
+        // Created by the first node attached, released when the shader variant changes
+        MaterialParameter* pColor = nullptr;
+        MaterialParameter* pDiffuse = nullptr;
+        MaterialParameter* pNormal = nullptr;
     };
 
     // nodeName - Material
     std::unordered_map<std::string, std::string> nodes;
 
+    // MaterialName - nodeNames, the reverse of nodes
+    std::unordered_map<std::string, std::unordered_set<std::string>> materialNodes;
+
     // MaterialName - Material Data (shader type)
     std::unordered_map<std::string, Mat> materials;
 
+    // Meshes shared between Models, mirrors the plugin's GeometryCache
+    struct Geometry
+    {
+        Mesh* pMesh = nullptr;
+        unsigned int users = 0;
+
+        // Vertex & index data last uploaded by updateMesh, the next update only uploads what differs from it
+        std::vector<char> shadow;
+    };
+
+    // Edits are diffed in blocks of this many vertices or indices
+    static const unsigned int DIRTY_BLOCK_SIZE = 64;
+
+    // Above this fraction of dirty blocks the whole buffer is uploaded instead
+    static constexpr float MAX_DIRTY_FRACTION = 0.5f;
+
+    // MeshInfoHeader::geometryHash - Geometry
+    std::unordered_map<uint64_t, Geometry> geometries;
+
+    // nodeName - geometryHash
+    std::unordered_map<std::string, uint64_t> nodeGeometry;
+
+    // Last TIME_SYNC, applied to every clip
+    TimeSyncHeader timeSync{};
+
 
     /**
-     * Draws the scene each frame.
+     * Adds a node's drawable to the render queue, unless it's outside the camera's frustum.
      */
-    bool drawScene(Node* node);
+    bool queueDrawable(Node* node);
+
+    // Object space sphere computed by the receiver, used for culling
+    void setBoundingSphere(const float* sphere, const char* nodeName);
+
+    // Message queue & budget overlay
+    void drawStats();
+
+    // Receives everything available, then handles deferred messages within the budget
+    void pumpMessages();
+    void handleMessage(ReceivedMessage& received);
+
+    // Transforms & cameras skip the queue, unless a deferred message renames or deletes their node or a transform's parent
+    bool isPriority(const ReceivedMessage& message) const;
+    void deferMessage(const ReceivedMessage& message);
+    void releasePendingNames(const ReceivedMessage& message);
+
+    // Seeks a node's clip to timeSync
+    bool syncClip(Node* node);
 
     // Helpers
     Mesh* createMesh(const MeshInfoHeader& info, void* data);
+    Mesh* createGeometry(const MeshInfoHeader& info, void* data, const char* nodeName);
+
+    void acquireGeometry(const char* nodeName, uint64_t hash, Mesh* pMesh);
+    void releaseGeometry(const char* nodeName);
+    bool isGeometryShared(const char* nodeName);
+
+    // Releases the geometry, material & components of pNode and everything below it, the nodes go with pNode's removal
+    void releaseSubtree(Node* pNode);
+
+    // PackedVertex meshes need the PACKED_VERTEX shader variant and their bounds to dequantize positions
+    bool isPacked(Model* pModel);
+    std::string getShaderDefines(Model* pModel);
+    void setVertexBounds(Model* pModel);
 
     void attachMaterial(const char* nodeName, const char* materialName);
-	void setMaterial(const MaterialDataHeader& header, const char* materialName);
-	void setMaterial(const TextureDataHeader& header, const char* materialName, bool diffuse);
+    void detachMaterial(const char* nodeName);
+	void setMaterial(const MaterialDeltaHeader& delta, const char* materialName);
+
+    // Puts pShared in place of pMaterial's own parameter, or makes that the shared one when there is none yet (returns true)
+    bool shareParameter(Material* pMaterial, const char* name, MaterialParameter*& pShared);
+    void releaseSharedParameters(Mat& mat);
+
+    // Updates the fields flagged in changed (MaterialField) on the shared parameters, for every node at once
+    void patchMaterial(Mat& mat, unsigned int changed);
 
     void createTexturedMaterial(Model* pModel, bool diffuse);
     void createColoredMaterial(Model* pModel);
 
-    void createNode(const MeshInfoHeader& header, void* pMeshData, const char* nodeName);
-    void recreateMesh(const MeshInfoHeader& header, void* pMeshData, const char* nodeName);
+    // Rebuilds a model's material, its shader depends on the vertex layout and skin
+    void resetMaterial(Model* pModel, const char* nodeName);
+
+    // Handles a whole MESH_NEW or MESH_UPDATE message, sent at once or reassembled from chunks by the receiver
+    void receiveMesh(Headers header, char* message, const char* nodeName);
+
+    void setMesh(Mesh* pMesh, const char* nodeName);
+    void createNode(Mesh* pMesh, const char* nodeName);
+    void recreateMesh(Mesh* pMesh, const char* nodeName);
     void updateMesh(char* meshData, const MeshInfoHeader& meshInfo, const char* nodeName);
+
+    // Uploads the vertex & index ranges of pNew that differ from pOld, both hold a whole mesh laid out as meshInfo
+    void uploadChanges(Mesh* pMesh, MeshPart* pPart, const char* pOld, const char* pNew, const MeshInfoHeader& meshInfo);
     void setTransform(const float* matrix, const char* nodeName);
+    void setParent(Node* pNode, const char* parentName);
     void setCamera(const CameraHeader& camHeader, const char* nodeName);
+    void setAnimationClip(const AnimationClipHeader& header, const TransformKey* pKeys, const char* nodeName);
+    void setSkin(const SkinDataHeader& header, const float* pInverseBinds, const char* nodeName);
+    void setJointMatrices(const JointMatricesHeader& header, const float* pMatrices, const char* nodeName);
 
     Camera* createCamera(const CameraHeader& cameraHeader);
 
@@ -0,0 +1,442 @@
+#include "MessageReceiver.h"
+#include "TangentFrames.h"
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <new>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define MESSAGE_RECEIVER_SSE
+#endif
+
+MessageReceiver::MessageReceiver(Comlib* pComlib)
+	:pComlib(pComlib)
+{
+}
+
+MessageReceiver::~MessageReceiver()
+{
+	stop();
+
+	ReceivedMessage message;
+	while (queue.pop(message))
+		delete[] message.data;
+}
+
+void MessageReceiver::start()
+{
+	if (running)
+		return;
+
+	running = true;
+	thread = std::thread(&MessageReceiver::run, this);
+}
+
+void MessageReceiver::stop()
+{
+	if (!running)
+		return;
+
+	running = false;
+	thread.join();
+}
+
+bool MessageReceiver::pop(ReceivedMessage& message)
+{
+	if (!queue.pop(message))
+		return false;
+
+	bytes.fetch_sub(message.header.messageLength, std::memory_order_relaxed);
+	return true;
+}
+
+void MessageReceiver::run()
+{
+	const std::chrono::milliseconds idle(1);
+
+	while (running)
+	{
+		ReceivedMessage message;
+
+		// Streams still being reassembled don't hold the ring up, their remaining chunks are in it
+		if (queuedBytes() - streamBytes >= MAX_QUEUED_BYTES || !receive(message))
+		{
+			std::this_thread::sleep_for(idle);
+			continue;
+		}
+
+		if (!decode(message))
+			continue;
+
+		// Counted before the push, so the main thread's pop never subtracts it first
+		bytes.fetch_add(message.header.messageLength, std::memory_order_relaxed);
+
+		// The main thread is behind, wait for room rather than lose the message
+		while (!queue.push(message))
+		{
+			if (!running)
+			{
+				bytes.fetch_sub(message.header.messageLength, std::memory_order_relaxed);
+				delete[] message.data;
+				return;
+			}
+			std::this_thread::sleep_for(idle);
+		}
+	}
+}
+
+bool MessageReceiver::receive(ReceivedMessage& message)
+{
+	SectionHeader* pHeader = nullptr;
+	for (int attempt = 0; attempt < 2; attempt++)
+	{
+		if (pComlib->Recieve(message.data, pHeader))
+		{
+			// The header lives in the ring, which the plugin is free to overwrite from here on
+			message.header = *pHeader;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool MessageReceiver::decode(ReceivedMessage& message)
+{
+	if (!isValid(message.header, message.data))
+	{
+		drop(message, L"MessageReceiver | Malformed message...\n");
+		return false;
+	}
+
+	switch (message.header.header)
+	{
+	case MESH_CHUNK:
+		if (!receiveChunk(message))
+			return false;
+
+		// Whole again, continues as the mesh it was cut from
+		if (!isValid(message.header, message.data))
+		{
+			drop(message, L"MessageReceiver | Malformed chunked mesh...\n");
+			return false;
+		}
+
+		expandRawMesh(message);
+		computeBoundingSphere(message);
+		return true;
+
+	case MESH_NEW:
+	case MESH_UPDATE:
+		expandRawMesh(message);
+		computeBoundingSphere(message);
+		return true;
+
+	case NODE_DELETE:
+	{
+		auto stream = meshChunks.find(message.header.name.cStr);
+		if (stream != meshChunks.end())
+			eraseStream(stream);
+		return true;
+	}
+
+	default:
+		return true;
+	}
+}
+
+bool MessageReceiver::receiveChunk(ReceivedMessage& message)
+{
+	MeshChunkHeader chunk;
+	memcpy(&chunk, message.data, sizeof(MeshChunkHeader));
+
+	const size_t chunkBytes = message.header.messageLength - sizeof(MeshChunkHeader);
+
+	// totalSize & the range are checked by isValid
+	auto stream = meshChunks.find(message.header.name.cStr);
+	if (chunk.offset == 0)
+	{
+		// Starts over, whatever was left of an earlier stream for the node is stale
+		if (stream != meshChunks.end())
+			eraseStream(stream);
+
+		// Streams abandoned part way give way to the new one, so they never add up past the limit
+		while (!meshChunks.empty() && streamBytes + chunk.totalSize > MAX_QUEUED_BYTES)
+			eraseStream(meshChunks.begin());
+
+		ChunkStream started;
+		started.data.reset(new (std::nothrow) char[chunk.totalSize]);
+		if (started.data)
+		{
+			started.totalSize = chunk.totalSize;
+			streamBytes += chunk.totalSize;
+			bytes.fetch_add(chunk.totalSize, std::memory_order_relaxed);
+
+			stream = meshChunks.emplace(message.header.name.cStr, std::move(started)).first;
+		}
+	}
+
+	// Missed the start, a chunk is missing or out of order (or out of memory), the next stream for this node starts over
+	if (stream == meshChunks.end() || stream->second.totalSize != chunk.totalSize || chunk.offset != stream->second.received)
+	{
+		if (stream != meshChunks.end())
+			eraseStream(stream);
+
+		drop(message, L"MESH_CHUNK | Incomplete mesh stream...\n");
+		return false;
+	}
+
+	memcpy(stream->second.data.get() + chunk.offset, message.data + sizeof(MeshChunkHeader), chunkBytes);
+	stream->second.received += chunkBytes;
+
+	delete[] message.data;
+	message.data = nullptr;
+
+	if (stream->second.received != chunk.totalSize)
+		return false;
+
+	// Last chunk, the full mesh replaces the proxy. Counted again once it's queued
+	message.header.header = chunk.header;
+	message.header.messageLength = chunk.totalSize;
+	message.data = stream->second.data.release();
+	eraseStream(stream);
+
+	return true;
+}
+
+void MessageReceiver::eraseStream(std::unordered_map<std::string, ChunkStream>::iterator stream)
+{
+	streamBytes -= stream->second.totalSize;
+	bytes.fetch_sub(stream->second.totalSize, std::memory_order_relaxed);
+	meshChunks.erase(stream);
+}
+
+bool MessageReceiver::isValid(const SectionHeader& header, const char* data) const
+{
+	const size_t length = header.messageLength;
+
+	// Fixed size header, optionally followed by count elements
+	auto fits = [length](size_t headerSize, size_t count = 0, size_t elementSize = 0)
+	{
+		return length >= headerSize && (length - headerSize) / (elementSize ? elementSize : 1) >= count;
+	};
+
+	switch (header.header)
+	{
+	case MESH_NEW:
+	case MESH_UPDATE:
+	{
+		if (!fits(sizeof(MeshInfoHeader)))
+			return false;
+
+		MeshInfoHeader info;
+		memcpy(&info, data, sizeof(MeshInfoHeader));
+		if (info.layout > VERTEX_RAW || info.numIndex % 3 != 0)
+			return false;
+
+		const uint64_t meshBytes = (uint64_t)info.numVertex * vertexSize(info.layout) + (uint64_t)info.numIndex * sizeof(int);
+		if (meshBytes > length - sizeof(MeshInfoHeader))
+			return false;
+
+		// Out of range indices would read past the vertices, on this thread for raw meshes and on the GPU otherwise
+		const int* pIndices = (const int*)(data + sizeof(MeshInfoHeader) + (size_t)info.numVertex * vertexSize(info.layout));
+		for (unsigned int i = 0; i < info.numIndex; i++)
+		{
+			if ((unsigned int)pIndices[i] >= info.numVertex)
+				return false;
+		}
+
+		if (info.layout == VERTEX_RAW)
+		{
+			const RawVertex* pVertices = (const RawVertex*)(data + sizeof(MeshInfoHeader));
+			for (unsigned int i = 0; i < info.numVertex; i++)
+			{
+				if (pVertices[i].vertexId < 0)
+					return false;
+			}
+		}
+
+		return true;
+	}
+	case MESH_CHUNK:
+	{
+		if (!fits(sizeof(MeshChunkHeader)))
+			return false;
+
+		MeshChunkHeader chunk;
+		memcpy(&chunk, data, sizeof(MeshChunkHeader));
+		if (chunk.header != MESH_NEW && chunk.header != MESH_UPDATE)
+			return false;
+
+		// Allocated up front from the first chunk, a bad size must not reach new[]
+		if (chunk.totalSize == 0 || chunk.totalSize > MAX_QUEUED_BYTES)
+			return false;
+
+		// Written without overflowing, offset + bytes could wrap around
+		const size_t chunkBytes = length - sizeof(MeshChunkHeader);
+		return chunk.offset <= chunk.totalSize && chunkBytes <= chunk.totalSize - chunk.offset;
+	}
+	case MESH_INSTANCE:
+		return fits(sizeof(MeshInstanceHeader));
+	case TRANSFORM_DATA:
+		return fits(sizeof(TransformDataHeader));
+	case MATERIAL_DELTA:
+		return fits(sizeof(MaterialDeltaHeader));
+	case CAMERA_DATA:
+		return fits(sizeof(CameraHeader));
+	case NAME_CHANGE:
+		return fits(sizeof(NameChangeHeader));
+	case MESH_MATERIAL:
+		return fits(sizeof(MeshMaterialHeader));
+	case TIME_SYNC:
+		return fits(sizeof(TimeSyncHeader));
+	case ANIMATION_CLIP:
+	{
+		if (!fits(sizeof(AnimationClipHeader)))
+			return false;
+
+		AnimationClipHeader clip;
+		memcpy(&clip, data, sizeof(AnimationClipHeader));
+		return fits(sizeof(AnimationClipHeader), clip.numKeys, sizeof(TransformKey));
+	}
+	case SKIN_DATA:
+	{
+		if (!fits(sizeof(SkinDataHeader)))
+			return false;
+
+		SkinDataHeader skin;
+		memcpy(&skin, data, sizeof(SkinDataHeader));
+		return fits(sizeof(SkinDataHeader), skin.numJoints, sizeof(float[4][4]));
+	}
+	case JOINT_MATRICES:
+	{
+		if (!fits(sizeof(JointMatricesHeader)))
+			return false;
+
+		JointMatricesHeader joints;
+		memcpy(&joints, data, sizeof(JointMatricesHeader));
+		return fits(sizeof(JointMatricesHeader), joints.numJoints, sizeof(float[4][4]));
+	}
+	case NODE_DELETE:
+		return true;
+	default:
+		return false;
+	}
+}
+
+void MessageReceiver::expandRawMesh(ReceivedMessage& message)
+{
+	MeshInfoHeader info;
+	memcpy(&info, message.data, sizeof(MeshInfoHeader));
+
+	if (info.layout != VERTEX_RAW)
+		return;
+
+	const char* pRaw = message.data + sizeof(MeshInfoHeader);
+	const int* pIndices = (const int*)(pRaw + info.numVertex * sizeof(RawVertex));
+	const size_t vertexBytes = info.numVertex * sizeof(Vertex);
+	const size_t indexBytes = info.numIndex * sizeof(int);
+
+	const size_t length = sizeof(MeshInfoHeader) + vertexBytes + indexBytes;
+	char* pExpanded = new char[length];
+
+	buildTangentFrames((const RawVertex*)pRaw, info.numVertex, pIndices, info.numIndex, (Vertex*)(pExpanded + sizeof(MeshInfoHeader)));
+	memcpy(pExpanded + sizeof(MeshInfoHeader) + vertexBytes, pIndices, indexBytes);
+
+	// geometryHash is kept, it still identifies the raw geometry
+	info.layout = VERTEX_FULL;
+	memcpy(pExpanded, &info, sizeof(MeshInfoHeader));
+
+	delete[] message.data;
+	message.data = pExpanded;
+	message.header.messageLength = length;
+}
+
+void MessageReceiver::computeBoundingSphere(ReceivedMessage& message)
+{
+	MeshInfoHeader info;
+	memcpy(&info, message.data, sizeof(MeshInfoHeader));
+
+	const char* pVertices = message.data + sizeof(MeshInfoHeader);
+	const size_t stride = vertexSize(info.layout);
+
+	float center[3];
+	for (int k = 0; k < 3; k++)
+		center[k] = (info.boundsMin[k] + info.boundsMax[k]) * 0.5f;
+
+	float radiusSq = 0.f;
+	unsigned int i = 0;
+
+	if (info.layout == VERTEX_PACKED)
+	{
+		// Positions are quantized within the bounds
+		float scale[3];
+		for (int k = 0; k < 3; k++)
+			scale[k] = (info.boundsMax[k] - info.boundsMin[k]) / 65535.f;
+
+		for (; i < info.numVertex; i++)
+		{
+			const PackedVertex& vertex = *(const PackedVertex*)(pVertices + i * stride);
+
+			float distanceSq = 0.f;
+			for (int k = 0; k < 3; k++)
+			{
+				const float d = info.boundsMin[k] + vertex.position[k] * scale[k] - center[k];
+				distanceSq += d * d;
+			}
+			radiusSq = std::max(radiusSq, distanceSq);
+		}
+	}
+	else
+	{
+		// Every other layout starts with a float position followed by more floats, 4 can be loaded at once
+#ifdef MESSAGE_RECEIVER_SSE
+		const __m128 c = _mm_set_ps(0.f, center[2], center[1], center[0]);
+		__m128 maxSq = _mm_setzero_ps();
+
+		// 4 vertices at a time, transposed so each lane sums one vertex's squared offsets
+		for (; i + 4 <= info.numVertex; i += 4)
+		{
+			__m128 d0 = _mm_sub_ps(_mm_loadu_ps((const float*)(pVertices + (i + 0) * stride)), c);
+			__m128 d1 = _mm_sub_ps(_mm_loadu_ps((const float*)(pVertices + (i + 1) * stride)), c);
+			__m128 d2 = _mm_sub_ps(_mm_loadu_ps((const float*)(pVertices + (i + 2) * stride)), c);
+			__m128 d3 = _mm_sub_ps(_mm_loadu_ps((const float*)(pVertices + (i + 3) * stride)), c);
+			_MM_TRANSPOSE4_PS(d0, d1, d2, d3);
+
+			const __m128 distanceSq = _mm_add_ps(_mm_add_ps(_mm_mul_ps(d0, d0), _mm_mul_ps(d1, d1)), _mm_mul_ps(d2, d2));
+			maxSq = _mm_max_ps(maxSq, distanceSq);
+		}
+
+		float lanes[4];
+		_mm_storeu_ps(lanes, maxSq);
+		radiusSq = std::max(std::max(lanes[0], lanes[1]), std::max(lanes[2], lanes[3]));
+#endif
+
+		for (; i < info.numVertex; i++)
+		{
+			const float* pPosition = (const float*)(pVertices + i * stride);
+
+			float distanceSq = 0.f;
+			for (int k = 0; k < 3; k++)
+			{
+				const float d = pPosition[k] - center[k];
+				distanceSq += d * d;
+			}
+			radiusSq = std::max(radiusSq, distanceSq);
+		}
+	}
+
+	memcpy(message.boundingSphere, center, sizeof(center));
+	message.boundingSphere[3] = std::sqrt(radiusSq);
+}
+
+void MessageReceiver::drop(ReceivedMessage& message, const wchar_t* reason)
+{
+	OutputDebugString(reason);
+
+	delete[] message.data;
+	message.data = nullptr;
+	dropped.fetch_add(1, std::memory_order_relaxed);
+}
@@ -0,0 +1,145 @@
+#ifndef MessageReceiver_H_
+#define MessageReceiver_H_
+
+#include "../../Memory/Comlib.h"
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+// A message taken from the ring & decoded, data (header.messageLength bytes) is new[]'d and owned by the holder
+struct ReceivedMessage
+{
+	SectionHeader header;
+	char* data = nullptr;
+
+	// MESH_NEW & MESH_UPDATE only, object space center (xyz) & radius of the vertices
+	float boundingSphere[4] = {};
+};
+
+/*
+	Lock-free queue between exactly one producer thread and one consumer thread.
+	Holds up to CAPACITY - 1 items, push & pop fail instead of waiting.
+*/
+template<typename T, size_t CAPACITY>
+class SpscQueue
+{
+public:
+	// Producer only
+	bool push(const T& item)
+	{
+		const size_t head = this->head.load(std::memory_order_relaxed);
+		const size_t next = (head + 1) % CAPACITY;
+		if (next == tail.load(std::memory_order_acquire))
+			return false;
+
+		items[head] = item;
+		this->head.store(next, std::memory_order_release);
+		return true;
+	}
+
+	// Consumer only
+	bool pop(T& item)
+	{
+		const size_t tail = this->tail.load(std::memory_order_relaxed);
+		if (tail == head.load(std::memory_order_acquire))
+			return false;
+
+		item = items[tail];
+		this->tail.store((tail + 1) % CAPACITY, std::memory_order_release);
+		return true;
+	}
+
+	// Approximate from either thread
+	size_t size() const
+	{
+		const size_t head = this->head.load(std::memory_order_acquire);
+		const size_t tail = this->tail.load(std::memory_order_acquire);
+		return (head + CAPACITY - tail) % CAPACITY;
+	}
+
+private:
+	T items[CAPACITY];
+
+	// A cache line apart, the two threads write one each. Padded rather than alignas(64): the queue is a member of
+	// new'd objects, which aren't over-aligned before C++17
+	std::atomic<size_t> head{ 0 };
+	char padding[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> tail{ 0 };
+};
+
+/*
+	Drains the Comlib on its own thread so copying, validating & decoding never stalls rendering.
+	MESH_CHUNK streams are reassembled into the MESH_NEW or MESH_UPDATE they were cut from,
+	VERTEX_RAW meshes get their tangent frames rebuilt into VERTEX_FULL, meshes get a bounding sphere for culling
+	and malformed messages are dropped.
+	The main thread pops the results in arrival order and only has to create meshes, upload & apply them.
+*/
+class MessageReceiver
+{
+public:
+	static const size_t QUEUE_CAPACITY = 4096;
+
+	// Stop taking from the ring once this much is decoded and waiting, the plugin then waits on a full ring.
+	// Also the largest mesh a MESH_CHUNK stream may reassemble
+	static const size_t MAX_QUEUED_BYTES = 256 * MB;
+
+	MessageReceiver(Comlib* pComlib);
+	~MessageReceiver();
+
+	void start();
+	void stop();
+
+	// Main thread only
+	bool pop(ReceivedMessage& message);
+
+	size_t queuedMessages() const { return queue.size(); }
+	size_t queuedBytes() const { return bytes.load(std::memory_order_relaxed); }
+	size_t droppedMessages() const { return dropped.load(std::memory_order_relaxed); }
+
+private:
+	struct ChunkStream
+	{
+		std::unique_ptr<char[]> data;
+		size_t totalSize = 0;
+
+		// Chunks have to arrive in order, the next one starts here
+		size_t received = 0;
+	};
+
+	void run();
+
+	// Either of the first two Recieve calls can hit a wrap marker
+	bool receive(ReceivedMessage& message);
+
+	// False when the message is dropped or not complete yet, data is then taken care of
+	bool decode(ReceivedMessage& message);
+	bool receiveChunk(ReceivedMessage& message);
+	void eraseStream(std::unordered_map<std::string, ChunkStream>::iterator stream);
+	bool isValid(const SectionHeader& header, const char* data) const;
+
+	// VERTEX_RAW meshes are replaced with VERTEX_FULL ones
+	void expandRawMesh(ReceivedMessage& message);
+
+	// Fills boundingSphere, around the center of the mesh's bounding box
+	void computeBoundingSphere(ReceivedMessage& message);
+
+	void drop(ReceivedMessage& message, const wchar_t* reason);
+
+	Comlib* pComlib;
+	std::thread thread;
+	std::atomic<bool> running{ false };
+
+	SpscQueue<ReceivedMessage, QUEUE_CAPACITY> queue;
+	std::atomic<size_t> bytes{ 0 };
+	std::atomic<size_t> dropped{ 0 };
+
+	// nodeName - MESH_CHUNK payloads received so far, see MeshChunkHeader. Receive thread only
+	std::unordered_map<std::string, ChunkStream> meshChunks;
+
+	// Allocated by meshChunks, also counted in bytes. Kept below MAX_QUEUED_BYTES on its own, see receiveChunk
+	size_t streamBytes = 0;
+};
+
+#endif
@@ -0,0 +1,205 @@
+#include "TangentFrames.h"
+#include "ThreadPool.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__SSE2__)
+#include <xmmintrin.h>
+#define TANGENT_FRAMES_SSE
+#endif
+
+namespace
+{
+
+// Fewer items than this per thread isn't worth handing to the ThreadPool
+const unsigned int MIN_ITEMS_PER_THREAD = 16384;
+
+#ifdef TANGENT_FRAMES_SSE
+
+// xyz, w is kept at 0 so dot & cross can work on whole registers
+typedef __m128 Vec;
+
+inline Vec vec(float x, float y, float z) { return _mm_set_ps(0.f, z, y, x); }
+inline Vec zero() { return _mm_setzero_ps(); }
+inline Vec load(const float* p) { return _mm_loadu_ps(p); }
+inline void store(float* p, Vec v) { _mm_storeu_ps(p, v); }
+inline Vec add(Vec a, Vec b) { return _mm_add_ps(a, b); }
+inline Vec sub(Vec a, Vec b) { return _mm_sub_ps(a, b); }
+inline Vec mul(Vec a, float s) { return _mm_mul_ps(a, _mm_set1_ps(s)); }
+
+inline void store3(float* p, Vec v)
+{
+	float values[4];
+	_mm_storeu_ps(values, v);
+	memcpy(p, values, sizeof(float) * 3);
+}
+
+inline float dot(Vec a, Vec b)
+{
+	const Vec product = _mm_mul_ps(a, b);
+	const Vec sum = _mm_add_ps(product, _mm_movehl_ps(product, product));
+	return _mm_cvtss_f32(_mm_add_ss(sum, _mm_shuffle_ps(sum, sum, _MM_SHUFFLE(1, 1, 1, 1))));
+}
+
+inline Vec cross(Vec a, Vec b)
+{
+	// (a * b.yzx - a.yzx * b).yzx
+	const Vec aYzx = _mm_shuffle_ps(a, a, _MM_SHUFFLE(3, 0, 2, 1));
+	const Vec bYzx = _mm_shuffle_ps(b, b, _MM_SHUFFLE(3, 0, 2, 1));
+	const Vec result = _mm_sub_ps(_mm_mul_ps(a, bYzx), _mm_mul_ps(aYzx, b));
+	return _mm_shuffle_ps(result, result, _MM_SHUFFLE(3, 0, 2, 1));
+}
+
+#else
+
+struct Vec { float x, y, z, w; };
+
+inline Vec vec(float x, float y, float z) { return { x, y, z, 0.f }; }
+inline Vec zero() { return { 0.f, 0.f, 0.f, 0.f }; }
+inline Vec load(const float* p) { return { p[0], p[1], p[2], p[3] }; }
+inline void store(float* p, Vec v) { memcpy(p, &v, sizeof(Vec)); }
+inline void store3(float* p, Vec v) { memcpy(p, &v, sizeof(float) * 3); }
+inline Vec add(Vec a, Vec b) { return { a.x + b.x, a.y + b.y, a.z + b.z, 0.f }; }
+inline Vec sub(Vec a, Vec b) { return { a.x - b.x, a.y - b.y, a.z - b.z, 0.f }; }
+inline Vec mul(Vec a, float s) { return { a.x * s, a.y * s, a.z * s, 0.f }; }
+inline float dot(Vec a, Vec b) { return a.x * b.x + a.y * b.y + a.z * b.z; }
+
+inline Vec cross(Vec a, Vec b)
+{
+	return { a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x, 0.f };
+}
+
+#endif
+
+inline Vec loadPosition(const RawVertex& vertex)
+{
+	return vec(vertex.position[0], vertex.position[1], vertex.position[2]);
+}
+
+inline Vec normalize(Vec v, Vec fallback)
+{
+	const float lengthSq = dot(v, v);
+	return lengthSq > 1e-24f ? mul(v, 1.f / std::sqrt(lengthSq)) : fallback;
+}
+
+// Any unit vector perpendicular to a unit normal
+inline Vec perpendicular(Vec normal)
+{
+	const Vec axis = std::fabs(dot(normal, vec(1.f, 0.f, 0.f))) < 0.9f ? vec(1.f, 0.f, 0.f) : vec(0.f, 1.f, 0.f);
+	return normalize(cross(normal, axis), vec(1.f, 0.f, 0.f));
+}
+
+// Stored with a 4th component so the SSE path can load & store whole registers
+struct TriangleFrame
+{
+	float normal[4];	// Not normalized, length is twice the area
+	float tangent[4];
+	float biNormal[4];
+};
+
+}
+
+void buildTangentFrames(const RawVertex* pVertices, unsigned int numVertex, const int* pIndices, unsigned int numIndex, Vertex* pOut)
+{
+	const unsigned int numTriangles = numIndex / 3;
+	const unsigned int numCorners = numTriangles * 3;
+
+	// Per triangle normal, and the tangent & binormal along its uv directions
+	std::vector<TriangleFrame> triangles(numTriangles);
+	gameplay::ThreadPool::parallelFor(numTriangles, MIN_ITEMS_PER_THREAD, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const RawVertex& v0 = pVertices[pIndices[i * 3 + 0]];
+			const RawVertex& v1 = pVertices[pIndices[i * 3 + 1]];
+			const RawVertex& v2 = pVertices[pIndices[i * 3 + 2]];
+
+			const Vec p0 = loadPosition(v0);
+			const Vec edge1 = sub(loadPosition(v1), p0);
+			const Vec edge2 = sub(loadPosition(v2), p0);
+
+			TriangleFrame& triangle = triangles[i];
+			store(triangle.normal, cross(edge1, edge2));
+
+			const float du1 = v1.uv[0] - v0.uv[0];
+			const float dv1 = v1.uv[1] - v0.uv[1];
+			const float du2 = v2.uv[0] - v0.uv[0];
+			const float dv2 = v2.uv[1] - v0.uv[1];
+
+			// Degenerate uvs, contributes nothing to the tangents
+			const float determinant = du1 * dv2 - du2 * dv1;
+			if (std::fabs(determinant) < 1e-20f)
+			{
+				store(triangle.tangent, zero());
+				store(triangle.biNormal, zero());
+				continue;
+			}
+
+			const float invDeterminant = 1.f / determinant;
+			store(triangle.tangent, mul(sub(mul(edge1, dv2), mul(edge2, dv1)), invDeterminant));
+			store(triangle.biNormal, mul(sub(mul(edge2, du1), mul(edge1, du2)), invDeterminant));
+		}
+	});
+
+	// Corners (index into pIndices) touching each Maya vertex, offsets[id] to offsets[id + 1]
+	unsigned int numIds = 0;
+	for (unsigned int i = 0; i < numVertex; i++)
+		numIds = std::max(numIds, (unsigned int)pVertices[i].vertexId + 1);
+
+	std::vector<unsigned int> offsets(numIds + 1, 0);
+	for (unsigned int i = 0; i < numCorners; i++)
+		offsets[pVertices[pIndices[i]].vertexId + 1]++;
+
+	for (unsigned int i = 0; i < numIds; i++)
+		offsets[i + 1] += offsets[i];
+
+	std::vector<unsigned int> corners(numCorners);
+	std::vector<unsigned int> cursors(offsets.begin(), offsets.end() - 1);
+	for (unsigned int i = 0; i < numCorners; i++)
+		corners[cursors[pVertices[pIndices[i]].vertexId]++] = i;
+
+	// Each face-vertex only reads shared data and writes its own output, no synchronization needed
+	gameplay::ThreadPool::parallelFor(numVertex, MIN_ITEMS_PER_THREAD, [&](unsigned int begin, unsigned int end)
+	{
+		for (unsigned int i = begin; i < end; i++)
+		{
+			const RawVertex& vertex = pVertices[i];
+			const unsigned int id = (unsigned int)vertex.vertexId;
+
+			Vec normal = zero();
+			Vec tangent = zero();
+			Vec biNormal = zero();
+
+			for (unsigned int c = offsets[id]; c < offsets[id + 1]; c++)
+			{
+				const unsigned int corner = corners[c];
+				const TriangleFrame& triangle = triangles[corner / 3];
+				normal = add(normal, load(triangle.normal));
+
+				const RawVertex& other = pVertices[pIndices[corner]];
+				if (other.uv[0] == vertex.uv[0] && other.uv[1] == vertex.uv[1])
+				{
+					tangent = add(tangent, load(triangle.tangent));
+					biNormal = add(biNormal, load(triangle.biNormal));
+				}
+			}
+
+			normal = normalize(normal, vec(0.f, 1.f, 0.f));
+
+			// Gram-Schmidt, keeps the frame orthonormal
+			tangent = normalize(sub(tangent, mul(normal, dot(normal, tangent))), perpendicular(normal));
+
+			const Vec side = cross(normal, tangent);
+			biNormal = dot(side, biNormal) < 0.f ? mul(side, -1.f) : side;
+
+			Vertex& out = pOut[i];
+			memcpy(out.position, vertex.position, sizeof(float) * 3);
+			memcpy(out.uv, vertex.uv, sizeof(float) * 2);
+			store3(out.normal, normal);
+			store3(out.tangent, tangent);
+			store3(out.biNormal, biNormal);
+		}
+	});
+}
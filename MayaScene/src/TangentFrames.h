@@ -0,0 +1,14 @@
+#ifndef TangentFrames_H_
+#define TangentFrames_H_
+
+#include "../../Memory/Headers.h"
+
+/*
+	Rebuilds normals, tangents & binormals of a VERTEX_RAW mesh into pOut (numVertex Vertex).
+	Normals are smoothed over every face-vertex of the same Maya vertex, weighted by triangle area.
+	Tangents & binormals are only smoothed over face-vertices that also share the uv, so uv seams stay split.
+	Large meshes are split over all hardware threads, the vector math uses SSE when available.
+*/
+void buildTangentFrames(const RawVertex* pVertices, unsigned int numVertex, const int* pIndices, unsigned int numIndex, Vertex* pOut);
+
+#endif
@@ -0,0 +1,241 @@
+#include "TextureLoader.h"
+#include <algorithm>
+#include <cstring>
+
+TextureLoader::TextureLoader()
+{
+}
+
+TextureLoader::~TextureLoader()
+{
+	stop();
+	clear();
+}
+
+void TextureLoader::clear()
+{
+	for (Decoded& texture : decoded)
+		SAFE_RELEASE(texture.pImage);
+	decoded.clear();
+
+	for (auto& parameter : waiting)
+		parameter.first->release();
+	waiting.clear();
+
+	for (auto& entry : entries)
+		SAFE_RELEASE(entry.second.pSampler);
+	entries.clear();
+
+	loading = 0;
+
+	SAFE_RELEASE(pWhite);
+	SAFE_RELEASE(pFlatNormal);
+}
+
+void TextureLoader::start()
+{
+	if (!threads.empty())
+		return;
+
+	if (!pWhite)
+		pWhite = createPlaceholder(255, 255, 255);
+	if (!pFlatNormal)
+		pFlatNormal = createPlaceholder(128, 128, 255);
+
+	// Decoding is mostly inflate & file IO, a few threads are plenty and leave the rest to the receiver & Maya
+	const unsigned int count = std::min(4u, std::max(1u, std::thread::hardware_concurrency() / 2));
+
+	stopping = false;
+	for (unsigned int i = 0; i < count; i++)
+		threads.emplace_back(&TextureLoader::run, this);
+}
+
+void TextureLoader::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+		jobs.clear();
+	}
+	jobAdded.notify_all();
+
+	for (std::thread& thread : threads)
+		thread.join();
+	threads.clear();
+}
+
+void TextureLoader::bind(MaterialParameter* pParameter, const char* path, bool normalMap)
+{
+	Entry& entry = entries[path];
+
+	// Only PNGs can be decoded off the main thread, compressed formats are cheap to load as they are
+	const size_t length = strlen(path);
+	const bool png = length >= 4 && (_stricmp(path + length - 4, ".png") == 0);
+
+	if (!entry.pSampler && !entry.loading && (!png || threads.empty()))
+	{
+		Texture* pTexture = Texture::create(path, true);
+		if (pTexture)
+		{
+			entry.pSampler = createSampler(pTexture);
+			SAFE_RELEASE(pTexture);
+		}
+		else
+		{
+			// Tried again on the next bind, the file may show up
+			entries.erase(path);
+		}
+	}
+
+	auto waited = waiting.find(pParameter);
+
+	auto loaded = entries.find(path);
+	if (loaded == entries.end() || loaded->second.pSampler)
+	{
+		// Ready, or failed and left to the placeholder
+		pParameter->setValue(loaded != entries.end() ? loaded->second.pSampler : (normalMap ? pFlatNormal : pWhite));
+
+		if (waited != waiting.end())
+		{
+			waiting.erase(waited);
+			pParameter->release();
+		}
+		return;
+	}
+
+	pParameter->setValue(normalMap ? pFlatNormal : pWhite);
+
+	if (waited != waiting.end())
+	{
+		waited->second = path;
+	}
+	else
+	{
+		pParameter->addRef();
+		waiting[pParameter] = path;
+	}
+
+	// Anyone else asking for the path in the meantime only waits along
+	if (!entry.loading)
+	{
+		entry.loading = true;
+		loading++;
+
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(path);
+		}
+		jobAdded.notify_one();
+	}
+}
+
+void TextureLoader::update()
+{
+	std::vector<Decoded> done;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		done.swap(decoded);
+	}
+
+	for (Decoded& texture : done)
+	{
+		auto entry = entries.find(texture.path);
+		if (entry == entries.end())
+		{
+			SAFE_RELEASE(texture.pImage);
+			continue;
+		}
+
+		entry->second.loading = false;
+		loading--;
+
+		Texture* pTexture = texture.pImage ? Texture::create(texture.pImage, true) : nullptr;
+		SAFE_RELEASE(texture.pImage);
+
+		Texture::Sampler* pSampler = nullptr;
+		if (pTexture)
+		{
+			pSampler = createSampler(pTexture);
+			SAFE_RELEASE(pTexture);
+			entry->second.pSampler = pSampler;
+		}
+		else
+		{
+			// The placeholders stay, the next bind of the path tries again
+			entries.erase(entry);
+		}
+
+		for (auto parameter = waiting.begin(); parameter != waiting.end();)
+		{
+			if (parameter->second != texture.path)
+			{
+				++parameter;
+				continue;
+			}
+
+			if (pSampler)
+				parameter->first->setValue(pSampler);
+
+			parameter->first->release();
+			parameter = waiting.erase(parameter);
+		}
+	}
+
+	// Textures no parameter uses anymore, the sampler is then only referenced here
+	for (auto entry = entries.begin(); entry != entries.end();)
+	{
+		if (entry->second.pSampler && entry->second.pSampler->getRefCount() == 1)
+		{
+			SAFE_RELEASE(entry->second.pSampler);
+			entry = entries.erase(entry);
+		}
+		else
+		{
+			++entry;
+		}
+	}
+}
+
+void TextureLoader::run()
+{
+	while (true)
+	{
+		std::string path;
+
+		{
+			std::unique_lock<std::mutex> lock(mutex);
+			jobAdded.wait(lock, [this] { return stopping || !jobs.empty(); });
+
+			if (stopping)
+				return;
+
+			path = std::move(jobs.front());
+			jobs.pop_front();
+		}
+
+		// CPU side only, no GL calls off the main thread
+		Image* pImage = Image::create(path.c_str());
+
+		std::lock_guard<std::mutex> lock(mutex);
+		decoded.push_back({ std::move(path), pImage });
+	}
+}
+
+Texture::Sampler* TextureLoader::createSampler(Texture* pTexture)
+{
+	Texture::Sampler* pSampler = Texture::Sampler::create(pTexture);
+	pSampler->setFilterMode(Texture::LINEAR_MIPMAP_LINEAR, Texture::LINEAR);
+	return pSampler;
+}
+
+Texture::Sampler* TextureLoader::createPlaceholder(unsigned char r, unsigned char g, unsigned char b)
+{
+	const unsigned char pixel[4] = { r, g, b, 255 };
+
+	Texture* pTexture = Texture::create(Texture::RGBA, 1, 1, pixel);
+	Texture::Sampler* pSampler = Texture::Sampler::create(pTexture);
+	pSampler->setFilterMode(Texture::NEAREST, Texture::NEAREST);
+	SAFE_RELEASE(pTexture);
+
+	return pSampler;
+}
@@ -0,0 +1,82 @@
+#ifndef TextureLoader_H_
+#define TextureLoader_H_
+
+#include "gameplay.h"
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+using namespace gameplay;
+
+/*
+	Decodes textures on a few background threads so a material change never stalls rendering on file IO & PNG decoding.
+	A parameter is bound to a placeholder right away and gets the real texture in a later update, once decoded.
+	Every path is loaded once, parameters asking for a path that's loading or loaded share its sampler.
+	Only the decoding is threaded, textures are created on the main thread which owns the GL context.
+*/
+class TextureLoader
+{
+public:
+	TextureLoader();
+	~TextureLoader();
+
+	// Main thread, with the GL context current
+	void start();
+	void stop();
+
+	// Main thread after stop, while the GL context is still current. Releases every texture, placeholder & waiting parameter
+	void clear();
+
+	// Binds path to pParameter, or a placeholder until it's loaded. A later bind to the same parameter takes over
+	void bind(MaterialParameter* pParameter, const char* path, bool normalMap);
+
+	// Main thread, once per frame. Creates the decoded textures & swaps them in for the placeholders
+	void update();
+
+	size_t loadingTextures() const { return loading; }
+
+private:
+	struct Entry
+	{
+		Texture::Sampler* pSampler = nullptr;
+		bool loading = false;
+	};
+
+	struct Decoded
+	{
+		std::string path;
+		Image* pImage = nullptr;
+	};
+
+	void run();
+
+	// Main thread, sampler for a texture of the viewer's filtering
+	static Texture::Sampler* createSampler(Texture* pTexture);
+
+	// 1x1 of a single color, for the parameters waiting on their texture
+	static Texture::Sampler* createPlaceholder(unsigned char r, unsigned char g, unsigned char b);
+
+	// path - the loaded sampler, or the load in flight. Main thread only
+	std::unordered_map<std::string, Entry> entries;
+
+	// Parameter - the path it waits on, the parameter is referenced until then
+	std::unordered_map<MaterialParameter*, std::string> waiting;
+	size_t loading = 0;
+
+	Texture::Sampler* pWhite = nullptr;
+	Texture::Sampler* pFlatNormal = nullptr;
+
+	std::vector<std::thread> threads;
+	std::deque<std::string> jobs;
+	std::vector<Decoded> decoded;
+	bool stopping = false;
+
+	std::mutex mutex;
+	std::condition_variable jobAdded;
+};
+
+#endif
@@ -1,4 +1,5 @@
 #pragma once
+#include <cstdint>
 #include "CharString.h"
 
 constexpr size_t MB = 1048576;
@@ -9,13 +10,25 @@ enum Headers : unsigned int
 	MESH_NEW,
 	MESH_UPDATE,
 	TRANSFORM_DATA,
-	MATERIAL_DATA,
+	MATERIAL_DELTA,
 	CAMERA_DATA,
 	NODE_DELETE,
 	NAME_CHANGE,
-	COLOR_TEXTURE,
-	NORMAL_TEXTURE,
-	MESH_MATERIAL
+	MESH_MATERIAL,
+	MESH_INSTANCE,
+	ANIMATION_CLIP,
+	TIME_SYNC,
+	SKIN_DATA,
+	JOINT_MATRICES,
+	MESH_CHUNK
+};
+
+enum VertexLayout : unsigned int
+{
+	VERTEX_FULL = 0,
+	VERTEX_PACKED,
+	VERTEX_SKINNED,
+	VERTEX_RAW
 };
 
 struct Vertex
@@ -27,6 +40,57 @@ struct Vertex
 	float biNormal[3];
 };
 
+/*
+	Compact alternative to Vertex, 20 bytes instead of 56.
+	position: xyz quantized to 0-65535 within MeshInfoHeader's bounds,
+	          w is 0 or 65535 and holds the sign of the binormal
+	uv: half floats
+	normal & tangent: octahedral encoded, signed normalized
+	The binormal is reconstructed in the shader as cross(normal, tangent) * sign
+*/
+struct PackedVertex
+{
+	uint16_t position[4];
+	uint16_t uv[2];
+	int16_t normal[2];
+	int16_t tangent[2];
+};
+
+// Bind pose Vertex with up to 4 joint influences, indices are stored as floats like gameplay's a_blendIndices
+struct SkinnedVertex
+{
+	Vertex vertex;
+	float blendWeights[4];
+	float blendIndices[4];
+};
+
+/*
+	Only what Maya gives cheaply, 24 bytes instead of 56.
+	The viewer rebuilds smooth normals, tangents & binormals from these,
+	vertexId (the Maya vertex) tells which face-vertices share a normal.
+*/
+struct RawVertex
+{
+	float position[3];
+	float uv[2];
+	int vertexId;
+};
+
+inline size_t vertexSize(VertexLayout layout)
+{
+	switch (layout)
+	{
+	case VERTEX_PACKED:
+		return sizeof(PackedVertex);
+	case VERTEX_SKINNED:
+		return sizeof(SkinnedVertex);
+	case VERTEX_RAW:
+		return sizeof(RawVertex);
+	default:
+		return sizeof(Vertex);
+	}
+}
+
 struct SectionHeader
 {
 	Headers header = Headers::INVALID;
@@ -41,21 +105,103 @@ struct MeshInfoHeader
 {
 	unsigned int numVertex;
 	unsigned int numIndex;
+
+	VertexLayout layout;
+
+	// Object space bounds, used to dequantize PackedVertex positions
+	float boundsMin[3];
+	float boundsMax[3];
+
+	// Hash of the whole message with this field set to 0, identifies the geometry for MESH_INSTANCE
+	uint64_t geometryHash;
+};
+
+/*
+	Slice of a MESH_NEW or MESH_UPDATE message too large to send at once,
+	followed by messageLength - sizeof(MeshChunkHeader) bytes of it, starting at offset.
+	A node's chunks arrive in order, the message is handled once all totalSize bytes are in.
+*/
+struct MeshChunkHeader
+{
+	Headers header;
+	size_t totalSize;
+	size_t offset;
+};
+
+// Points a node at geometry that was already sent for another node
+struct MeshInstanceHeader
+{
+	uint64_t geometryHash;
 };
 
 struct TransformDataHeader
 {
+	// Local matrix, relative to parentName
 	float transMtrx[4][4];
+
+	// Empty if the transform is parented to the world
+	CharString parentName;
 };
 
-struct MaterialDataHeader
+// Followed by numKeys TransformKeys, 0 keys removes the node's clip
+struct AnimationClipHeader
 {
-	float color[4];
+	unsigned int numKeys;
+};
+
+// Local transform sampled at one frame, laid out like Transform::ANIMATE_SCALE_ROTATE_TRANSLATE
+struct TransformKey
+{
+	// Milliseconds from the start of the playback range
+	unsigned int time;
+
+	float scale[3];
+	float rotation[4];	// quaternion xyzw
+	float translation[3];
+};
+
+// Sent when the Maya timeline changes, keeps clips in step with the current frame
+struct TimeSyncHeader
+{
+	// Milliseconds from the start of the playback range
+	float time;
+	bool playing;
+};
+
+/*
+	Sent after a VERTEX_SKINNED mesh, followed by numJoints inverse bind matrices (float[4][4]).
+	Joints are only referenced by index, JOINT_MATRICES uses the same order.
+*/
+struct SkinDataHeader
+{
+	unsigned int numJoints;
+	float bindShape[4][4];
 };
 
-struct TextureDataHeader
+// Followed by numJoints joint world matrices (float[4][4])
+struct JointMatricesHeader
 {
-	CharString path;
+	unsigned int numJoints;
+};
+
+// MaterialDeltaHeader::changed
+enum MaterialField : unsigned int
+{
+	MATERIAL_COLOR = 1 << 0,
+	MATERIAL_DIFFUSE = 1 << 1,
+	MATERIAL_NORMAL = 1 << 2
+};
+
+/*
+	Fields of a lambert that changed since it was last sent, only the ones flagged in changed are valid.
+	An empty path means the texture is disconnected, materials without a diffuse texture use the color.
+*/
+struct MaterialDeltaHeader
+{
+	unsigned int changed;
+	float color[4];
+	CharString diffuse;
+	CharString normal;
 };
 
 struct MeshMaterialHeader